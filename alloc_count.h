@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+
+/**
+ * Debug hook for proving the move path does not allocate. Compile with
+ * -DQL_COUNT_ALLOCS to route global operator new through a counter,
+ * trainAI then reports the heap allocations made per move.
+ */
+
+// Total calls to operator new since start (only counted with QL_COUNT_ALLOCS)
+static std::atomic<long> ct_allocations(0);
+
+#ifdef QL_COUNT_ALLOCS
+#if defined(__GNUC__) && !defined(__clang__)
+// GCC flags free() of a pointer from the (replaced) operator new
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void * operator new(size_t n) {
+    ct_allocations++;
+    void * p = malloc(n ? n : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void * p) noexcept {
+    free(p);
+}
+
+void operator delete(void * p, size_t) noexcept {
+    operator delete(p);
+}
+#endif
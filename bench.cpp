@@ -0,0 +1,623 @@
+#include "bench.h"
+#include <iomanip>
+
+// Results of benchmarked ops are folded in here so none is optimized
+// away, printed as a checksum (same seed and code, same checksum)
+uint64_t bench_sink = 0;
+
+/**
+ * Enter here.
+ * Takes command line flags:
+ * --filter N        filter size of the learner benchmarks (default 4)
+ * --values TYPE     table rewards as f32, i16 or f16 (default f32)
+ * --samples K       timed samples per benchmark (default 30)
+ * --seed S          seed of every benchmark's inputs
+ * --io-states LIST  comma separated table sizes to save / load, 0 for
+ *                   none (default 1000000,10000000,100000000)
+ * --update-states N table size of the update benchmarks, 0 for none
+ *                   (default 10000000)
+ * --update-batch U  updates per batch when batched (default 4096)
+ * --io-dir DIR      where the I/O benchmarks write (default .)
+ * --only NAME       only benchmarks whose name contains NAME
+ * --json FILE       write the results as JSON to FILE
+ * --baseline FILE   compare p50s against an earlier --json FILE
+ * --tolerance PCT   p50 slowdown allowed over the baseline (default 10)
+ * Exits 1 if a benchmark is slower than the baseline allows.
+ */
+int main(int argc, char *argv[]) {
+    BenchOptions opts;
+    if (parseBenchArgs(argc, argv, opts)) {
+        std::cout << "USAGE" << std::endl;
+        std::cout << "  --filter N --values f32|i16|f16 --samples K --seed S --io-states LIST --io-dir DIR --only NAME" << std::endl;
+        std::cout << "  --update-states N --update-batch U --json FILE --baseline FILE --tolerance PCT" << std::endl;
+        return 0;
+    }
+
+    // each filter size is its own compiled learner, as in driver.cpp
+    std::vector<BenchResult> results;
+    switch (opts.filter_size) {
+        case 3: runBenchmarks<3>(opts, results); break;
+        case 4: runBenchmarks<4>(opts, results); break;
+        case 5: runBenchmarks<5>(opts, results); break;
+        case 6: runBenchmarks<6>(opts, results); break;
+        default:
+            std::cout << "\033[1;31mFILTER SIZE MUST BE 3-6\033[0m" << std::endl;
+            return 1;
+    }
+    std::cout << "CHECKSUM: " << bench_sink << std::endl;
+
+    if (!opts.json.empty()) {
+        std::ofstream out(opts.json);
+        if (!out) {
+            std::cout << "\033[1;31mFAILED TO WRITE " << opts.json << "\033[0m" << std::endl;
+            return 1;
+        }
+        writeJSON(out, opts, results);
+        std::cout << "\033[1;32mWROTE: \033[0m" << opts.json << std::endl;
+    }
+
+    if (!opts.baseline.empty()) {
+        int regressed = compareBaseline(opts, results);
+        if (regressed < 0) {
+            std::cout << "\033[1;31mCAN'T READ BASELINE " << opts.baseline << "\033[0m" << std::endl;
+            return 1;
+        }
+        return regressed ? 1 : 0;
+    }
+    return 0;
+}
+
+
+/**
+ * Parses the benchmark command line (--flag value pairs only)
+ * @param opts set from the flags given
+ * @return non-zero on an unknown flag or one missing its value
+ */
+int parseBenchArgs(int argc, char *argv[], BenchOptions & opts) {
+    for (int i = 1; i < argc; i++) {
+        std::string flag = argv[i];
+        if (i + 1 >= argc) {
+            return -1;
+        }
+        std::string value = argv[++i];
+        if (flag == "--filter") {
+            opts.filter_size = atoi(value.c_str());
+        } else if (flag == "--values") {
+            int value_type = QTable::parseValueType(value);
+            if (value_type < 0) {
+                return -1;
+            }
+            opts.value_type = value_type;
+        } else if (flag == "--samples") {
+            opts.samples = std::max(1, atoi(value.c_str()));
+        } else if (flag == "--seed") {
+            opts.seed = strtoull(value.c_str(), nullptr, 0);
+        } else if (flag == "--io-states") {
+            opts.io_states.clear();
+            size_t at = 0;
+            while (at < value.size()) {
+                size_t comma = value.find(',', at);
+                long states = atol(value.substr(at, comma - at).c_str());
+                if (states > 0) {
+                    opts.io_states.push_back(states);
+                }
+                at = comma == std::string::npos ? value.size() : comma + 1;
+            }
+        } else if (flag == "--update-states") {
+            opts.update_states = std::max(0L, atol(value.c_str()));
+        } else if (flag == "--update-batch") {
+            opts.update_batch = std::max(1, atoi(value.c_str()));
+        } else if (flag == "--io-dir") {
+            opts.io_dir = value;
+        } else if (flag == "--only") {
+            opts.only = value;
+        } else if (flag == "--json") {
+            opts.json = value;
+        } else if (flag == "--baseline") {
+            opts.baseline = value;
+        } else if (flag == "--tolerance") {
+            opts.tolerance = atof(value.c_str());
+        } else {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * Time an op: a warm up run, then samples runs of ops calls of f(i)
+ * @return void
+ */
+template <typename F>
+void timeOps(std::string name, BenchOptions & opts, long ops, F f, std::vector<BenchResult> & results) {
+    if (name.find(opts.only) == std::string::npos) {
+        return;
+    }
+    long i = 0;
+    // untimed, warms caches and tables
+    for (long k = 0; k < ops; k++) {
+        f(i++);
+    }
+    std::vector<double> ns;
+    for (int s = 0; s < opts.samples; s++) {
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        for (long k = 0; k < ops; k++) {
+            f(i++);
+        }
+        std::chrono::duration<double, std::nano> t = std::chrono::steady_clock::now() - begin;
+        ns.push_back(t.count() / ops);
+    }
+    results.push_back(summarize(name, ops, ns));
+}
+
+
+/**
+ * Summarize sample timings as a result (nearest rank percentiles), and
+ * print it
+ * @return the result
+ */
+BenchResult summarize(std::string name, long ops, std::vector<double> ns) {
+    std::sort(ns.begin(), ns.end());
+    auto rank = [&](double q) {
+        size_t at = (size_t) std::ceil(q * ns.size());
+        return ns[std::min(ns.size() - 1, at ? at - 1 : 0)];
+    };
+    BenchResult r;
+    r.name = name;
+    r.ops = ops;
+    r.samples = (int) ns.size();
+    r.min = ns.front();
+    r.mean = 0;
+    for (double t : ns) {
+        r.mean += t / ns.size();
+    }
+    r.p50 = rank(0.5);
+    r.p90 = rank(0.9);
+    r.p99 = rank(0.99);
+
+    std::cout << "\033[1;36m" << std::left << std::setw(28) << r.name << "\033[0m" << std::right << std::fixed;
+    std::cout << std::setprecision(1) << " p50 " << std::setw(12) << r.p50 << " ns";
+    std::cout << "  p90 " << std::setw(12) << r.p90 << "  p99 " << std::setw(12) << r.p99;
+    std::cout << "  (" << std::setprecision(0) << 1e9 / r.p50 << "/sec)" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+    return r;
+}
+
+
+/**
+ * Random positions reached by random legal play, from the seed
+ * @param count the number of positions
+ * @return the positions, none of them won or full
+ */
+std::vector<Game> randomPositions(uint64_t seed, int count) {
+    std::mt19937_64 rng(seed);
+    std::vector<Game> positions;
+    while ((int) positions.size() < count) {
+        Game game;
+        int plies = rng() % 36;
+        int player = 1;
+        bool ended = false;
+        for (int p = 0; p < plies && !ended; p++) {
+            uint32_t legal = game.legalMoves();
+            int col = rng() % 7;
+            while (!((legal >> col) & 1)) {
+                col = (col + 1) % 7;
+            }
+            game.dropPiece(col, player, ended);
+            ended = ended || game.boardIsFull();
+            player = -player;
+        }
+        if (!ended) {
+            positions.push_back(game);
+        }
+    }
+    return positions;
+}
+
+
+/**
+ * Game benchmarks: dropPiece (through whole random games), checkForWin,
+ * getBoard, and an exact solve 10 cells from a full board
+ * @return void
+ */
+void benchGame(BenchOptions & opts, std::vector<BenchResult> & results) {
+    // a fixed run of random games: +/-(col + 1) for a drop by player 1 /
+    // -1, 0 to reset after a game ends
+    std::mt19937_64 rng(opts.seed + 1);
+    std::vector<int> drops;
+    Game game;
+    int player = 1;
+    while (drops.size() < (1 << 16) || drops.back() != 0) {
+        uint32_t legal = game.legalMoves();
+        int col = rng() % 7;
+        while (!((legal >> col) & 1)) {
+            col = (col + 1) % 7;
+        }
+        bool won = false;
+        game.dropPiece(col, player, won);
+        drops.push_back(player * (col + 1));
+        player = -player;
+        if (won || game.boardIsFull()) {
+            drops.push_back(0);
+            game.resetGame();
+            player = 1;
+        }
+    }
+
+    size_t at = 0;
+    timeOps("game.dropPiece", opts, 1 << 16, [&](long) {
+        int drop = drops[at];
+        if (++at == drops.size()) {
+            at = 0;
+        }
+        if (drop == 0) {
+            game.resetGame();
+            return;
+        }
+        bool won = false;
+        game.dropPiece((drop > 0 ? drop : -drop) - 1, drop > 0 ? 1 : -1, won);
+        bench_sink += won;
+    }, results);
+
+    std::vector<Game> positions = randomPositions(opts.seed, 4096);
+    timeOps("game.checkForWin", opts, 1 << 16, [&](long i) {
+        bench_sink += positions[i & 4095].checkForWin();
+    }, results);
+    timeOps("game.getBoard", opts, 1 << 16, [&](long i) {
+        bench_sink += positions[i & 4095].getBoard();
+    }, results);
+
+    // random play to 10 empty cells, games won before then dropped
+    std::vector<std::pair<uint64_t, uint64_t>> boundary;
+    while (boundary.size() < 1024) {
+        game.resetGame();
+        player = 1;
+        bool won = false;
+        while (!won && __builtin_popcountll(game.getMask()) < 32) {
+            uint32_t legal = game.legalMoves();
+            int col = rng() % 7;
+            while (!((legal >> col) & 1)) {
+                col = (col + 1) % 7;
+            }
+            game.dropPiece(col, player, won);
+            player = -player;
+        }
+        if (!won) {
+            // red is to move on 32 pieces
+            boundary.push_back({game.getPosition(), game.getMask()});
+        }
+    }
+    timeOps("tablebase.solve", opts, 1024, [&](long i) {
+        bench_sink += Tablebase::solve(boundary[i & 1023].first, boundary[i & 1023].second);
+    }, results);
+}
+
+
+/**
+ * Time the learner's steps on random positions: window keys, the
+ * greedy sweep and its argmax, a whole greedy move and an update, and a
+ * policy's move on repeated openings with and without its decision cache,
+ * and a fresh 6 ply search from them
+ * @return void
+ */
+template <int N>
+void QLearnerBench<N>::micro(BenchOptions & opts, std::vector<BenchResult> & results) {
+    const int filters = QLearner<N>::total_filters;
+    if (filters == 0) {
+        std::cout << "\033[1;31mNO WINDOWS FOR FILTER SIZE " << N << ", LEARNER BENCHMARKS SKIPPED\033[0m" << std::endl;
+        return;
+    }
+    std::vector<Game> positions = randomPositions(opts.seed, 4096);
+    srand((unsigned) opts.seed);
+    Game empty;
+    QLearner<N> learner(&empty, 0.1, 4, 1, opts.value_type);
+
+    // a greedy move from every position, recorded to replay its update
+    // (the table then holds every state the benchmarks look up)
+    std::vector<Game> after = positions;
+    std::vector<size_t> states(positions.size());
+    std::vector<int> hash_locs(positions.size());
+    std::vector<int> actions(positions.size());
+    std::vector<int> moves(positions.size());
+    for (size_t k = 0; k < positions.size(); k++) {
+        learner.game = &positions[k];
+        moves[k] = learner.makeMove(false);
+        states[k] = learner.state;
+        hash_locs[k] = learner.hash_loc;
+        actions[k] = learner.relative_action;
+        after[k].dropPiece(moves[k], 1);
+    }
+
+    timeOps("learner.getSubHash", opts, 1 << 16, [&](long i) {
+        Game & game = positions[i & 4095];
+        bench_sink += learner.getSubHash(i % filters, game.getPosition(), game.getMask());
+    }, results);
+    timeOps("learner.convGreedyDecider", opts, 1 << 14, [&](long i) {
+        learner.game = &positions[i & 4095];
+        bench_sink += learner.convGreedyDecider()[0];
+    }, results);
+
+    // random rewards and legal columns for every window at once
+    std::mt19937_64 rng(opts.seed + 2);
+    std::uniform_real_distribution<float> reward(-1, 1);
+    const int width = filters * N;
+    std::vector<float> candidates(4096 * width);
+    std::vector<uint64_t> legal(4096);
+    for (size_t k = 0; k < candidates.size(); k++) {
+        candidates[k] = reward(rng);
+    }
+    for (size_t k = 0; k < legal.size(); k++) {
+        legal[k] = rng();
+    }
+    timeOps("learner.maskedArgmax", opts, 1 << 16, [&](long i) {
+        float best;
+        bench_sink += QLearner<N>::maskedArgmax(&candidates[(i & 4095) * width], width, legal[i & 4095], best);
+    }, results);
+
+    timeOps("learner.greedyMove", opts, 1 << 14, [&](long i) {
+        learner.game = &positions[i & 4095];
+        bench_sink += learner.makeMove(false);
+    }, results);
+    timeOps("learner.update", opts, 1 << 14, [&](long i) {
+        int k = i & 4095;
+        learner.game = &after[k];
+        learner.state = states[k];
+        learner.hash_loc = hash_locs[k];
+        learner.relative_action = actions[k];
+        bench_sink += learner.update(0, moves[k]);
+    }, results);
+
+    // 4 random plies: a few hundred openings, each seen many times
+    std::vector<Game> openings(4096);
+    for (Game & game : openings) {
+        int player = 1;
+        for (int p = 0; p < 4; p++) {
+            game.dropPiece((int) (rng() % 7), player);
+            player = -player;
+        }
+    }
+    QPolicy<N> policy(&learner);
+    timeOps("policy.selectMove", opts, 1 << 14, [&](long i) {
+        bench_sink += policy.selectMove(openings[i & 4095]);
+    }, results);
+    policy.setCache(1 << 16);
+    timeOps("policy.selectMove.cached", opts, 1 << 14, [&](long i) {
+        bench_sink += policy.selectMove(openings[i & 4095]);
+    }, results);
+    QSearch<N> search(&policy, 1 << 14);
+    timeOps("search.depth6", opts, 16, [&](long i) {
+        Game & game = openings[i & 4095];
+        search.clear();
+        bench_sink += search.selectMove(game.getPosition(), game.getMask(), 0, 6);
+    }, results);
+    learner.game = &empty;
+}
+
+
+/**
+ * Time updates between random states of an opts.update_states table,
+ * applied at once and in sorted batches, ns per update. Past the cache
+ * size each immediate update misses twice (the next state, the state).
+ * @return void
+ */
+template <int N>
+void QLearnerBench<N>::updates(BenchOptions & opts, std::vector<BenchResult> & results) {
+    std::string immediate_name = "update.immediate." + std::to_string(opts.update_states);
+    std::string batched_name = "update.batched." + std::to_string(opts.update_states);
+    if (!opts.update_states ||
+        (immediate_name.find(opts.only) == std::string::npos && batched_name.find(opts.only) == std::string::npos)) {
+        return;
+    }
+    srand((unsigned) opts.seed);
+    Game empty;
+    QLearner<N> learner(&empty, 0.1, 4, 1, opts.value_type);
+    std::mt19937_64 rng(opts.seed + 3);
+    std::vector<uint64_t> keys(opts.update_states);
+    for (size_t k = 0; k < keys.size(); k++) {
+        keys[k] = rng() >> 1;
+        bool inserted;
+        void * rewards = learner.table->findOrInsert(keys[k], inserted);
+        for (int a = 0; a < N; a++) {
+            learner.table->set(rewards, a, (float) (rng() % 1000) * 0.01f);
+        }
+    }
+
+    // moves of a long run land all over the table, whole batches per
+    // sample so each sample pays for its flushes
+    int batch = std::max(opts.update_batch, 1);
+    const long n_updates = (((1 << 16) + batch - 1) / batch) * batch;
+    std::vector<QUpdate> updates(n_updates);
+    for (QUpdate & u : updates) {
+        u = {keys[rng() % keys.size()], (int) (rng() % N), 1, keys[rng() % keys.size()], false, 0};
+    }
+    timeOps(immediate_name, opts, n_updates, [&](long i) {
+        QUpdate u = updates[i % n_updates];
+        u.future = learner.futureReward(u.next_state);
+        learner.applyUpdate(u);
+    }, results);
+    learner.setUpdateBatch(opts.update_batch);
+    timeOps(batched_name, opts, n_updates, [&](long i) {
+        learner.updates->push_back(updates[i % n_updates]);
+        if ((int) learner.updates->size() >= opts.update_batch) {
+            learner.flushUpdates();
+        }
+    }, results);
+    learner.flushUpdates();
+    bench_sink += learner.table->size();
+}
+
+
+/**
+ * Self-play games, as trainAI plays them, ns per game
+ * @return void
+ */
+template <int N>
+void benchSelfPlay(BenchOptions & opts, std::vector<BenchResult> & results) {
+    srand((unsigned) opts.seed);
+    Game game;
+    QLearner<N> red(&game, 0.1, 4, 1, opts.value_type);
+    QLearner<N> black(&game, 0.1, 2, -1, opts.value_type);
+    long ct_moves = 0;
+    timeOps("selfplay.game", opts, 1000, [&](long) {
+        bench_sink += playTrainingGame(&red, &black, &game, ct_moves);
+    }, results);
+
+    // the same games again from fresh tables, ended 10 cells from a full
+    // board (solved as they come, as on a first run)
+    srand((unsigned) opts.seed);
+    QLearner<N> tb_red(&game, 0.1, 4, 1, opts.value_type);
+    QLearner<N> tb_black(&game, 0.1, 2, -1, opts.value_type);
+    Tablebase tablebase(10);
+    timeOps("selfplay.game.tablebase", opts, 1000, [&](long) {
+        bench_sink += playTrainingGame(&tb_red, &tb_black, &game, ct_moves, nullptr, &tablebase);
+    }, results);
+}
+
+
+/**
+ * Table save / load at each of opts.io_states, ns per state. A load
+ * maps the file, so it is timed with one pass over every reward.
+ * @return void
+ */
+template <int N>
+void benchIO(BenchOptions & opts, std::vector<BenchResult> & results) {
+    for (long states : opts.io_states) {
+        std::string save_name = "io.save." + std::to_string(states);
+        std::string load_name = "io.load." + std::to_string(states);
+        bool save = save_name.find(opts.only) != std::string::npos;
+        bool load = load_name.find(opts.only) != std::string::npos;
+        if (!save && !load) {
+            continue;
+        }
+
+        std::mt19937_64 rng(opts.seed + states);
+        QTable table(N, opts.value_type);
+        for (long k = 0; k < states; k++) {
+            bool inserted;
+            void * rewards = table.findOrInsert(rng() >> 1, inserted);
+            for (int a = 0; a < N; a++) {
+                table.set(rewards, a, (float) (rng() % 1000) * 0.01f);
+            }
+        }
+        std::string fname = opts.io_dir + "/bench." + std::to_string(states) + ".qtab";
+
+        // a few samples only, each one is seconds at the larger sizes
+        int samples = std::min(opts.samples, 5);
+        std::vector<double> save_ns;
+        std::vector<double> load_ns;
+        for (int s = 0; s < samples; s++) {
+            std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+            if (table.save(fname, QLearner<N>::HASH_SCHEME, nullptr) < 0) {
+                std::cout << "\033[1;31mFAILED TO SAVE " << fname << "\033[0m" << std::endl;
+                return;
+            }
+            std::chrono::duration<double, std::nano> t = std::chrono::steady_clock::now() - begin;
+            save_ns.push_back(t.count() / table.size());
+
+            begin = std::chrono::steady_clock::now();
+            QTable loaded(N, opts.value_type);
+            loaded.load(fname, QLearner<N>::HASH_SCHEME, nullptr);
+            float sum = 0;
+            loaded.forEach([&](uint64_t, void * rewards) {
+                sum += loaded.get(rewards, 0);
+            });
+            bench_sink += (uint64_t) sum;
+            t = std::chrono::steady_clock::now() - begin;
+            load_ns.push_back(t.count() / table.size());
+        }
+        remove(fname.c_str());
+        if (save) {
+            results.push_back(summarize(save_name, (long) table.size(), save_ns));
+        }
+        if (load) {
+            results.push_back(summarize(load_name, (long) table.size(), load_ns));
+        }
+    }
+}
+
+
+/**
+ * Run every benchmark for filter size N
+ * @return void
+ */
+template <int N>
+void runBenchmarks(BenchOptions & opts, std::vector<BenchResult> & results) {
+    std::cout << "\033[1;36mBENCHMARKS: \033[0mfilter size " << N << ", " << QTable::valueTypeName(opts.value_type);
+    std::cout << " rewards, seed " << opts.seed;
+    std::cout << ", " << opts.samples << " samples" << std::endl;
+    benchGame(opts, results);
+    QLearnerBench<N>::micro(opts, results);
+    QLearnerBench<N>::updates(opts, results);
+    benchSelfPlay<N>(opts, results);
+    benchIO<N>(opts, results);
+}
+
+
+/**
+ * Write results as JSON, one benchmark per line
+ * @return void
+ */
+void writeJSON(std::ostream & out, BenchOptions & opts, std::vector<BenchResult> & results) {
+    out << "{" << std::endl;
+    out << "  \"seed\": " << opts.seed << "," << std::endl;
+    out << "  \"filter_size\": " << opts.filter_size << "," << std::endl;
+    out << "  \"value_type\": \"" << QTable::valueTypeName(opts.value_type) << "\"," << std::endl;
+    out << "  \"benchmarks\": [" << std::endl;
+    out << std::setprecision(6);
+    for (size_t i = 0; i < results.size(); i++) {
+        BenchResult & r = results[i];
+        out << "    {\"name\": \"" << r.name << "\", \"ops\": " << r.ops << ", \"samples\": " << r.samples;
+        out << ", \"min_ns\": " << r.min << ", \"mean_ns\": " << r.mean << ", \"p50_ns\": " << r.p50;
+        out << ", \"p90_ns\": " << r.p90 << ", \"p99_ns\": " << r.p99 << "}";
+        out << (i + 1 < results.size() ? "," : "") << std::endl;
+    }
+    out << "  ]," << std::endl;
+    out << "  \"checksum\": " << bench_sink << std::endl;
+    out << "}" << std::endl;
+}
+
+
+/**
+ * Compare results against a JSON baseline (as writeJSON writes it) by
+ * p50, printing each change
+ * @return the number of benchmarks slower than the tolerance allows,
+ * -1 if the baseline can't be read
+ */
+int compareBaseline(BenchOptions & opts, std::vector<BenchResult> & results) {
+    std::ifstream in(opts.baseline);
+    if (!in) {
+        return -1;
+    }
+    std::map<std::string, double> base;
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t name = line.find("\"name\": \"");
+        size_t p50 = line.find("\"p50_ns\": ");
+        if (name == std::string::npos || p50 == std::string::npos) {
+            continue;
+        }
+        name += 9;
+        base[line.substr(name, line.find('"', name) - name)] = atof(line.c_str() + p50 + 10);
+    }
+
+    int regressed = 0;
+    std::cout << std::endl << "\033[1;36mAGAINST " << opts.baseline << "\033[0m (p50, tolerance ";
+    std::cout << opts.tolerance << "%)" << std::endl;
+    for (BenchResult & r : results) {
+        std::cout << std::left << std::setw(28) << r.name << std::right;
+        if (!base.count(r.name) || base[r.name] <= 0) {
+            std::cout << " new" << std::endl;
+            continue;
+        }
+        double change = 100 * (r.p50 - base[r.name]) / base[r.name];
+        bool slower = change > opts.tolerance;
+        regressed += slower;
+        std::cout << (slower ? "\033[1;31m" : "\033[1;32m") << std::showpos << std::fixed << std::setprecision(1);
+        std::cout << std::setw(8) << change << "%" << std::noshowpos << (slower ? "  REGRESSED" : "") << "\033[0m" << std::endl;
+        std::cout.unsetf(std::ios::floatfield);
+        std::cout << std::setprecision(6);
+    }
+    return regressed;
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include "game.h"
+#include "game.cpp"
+#include <iostream>
+#include "q.h"
+#include "telemetry.cpp"
+#include "qtable.cpp"
+#include "concurrent_qtable.cpp"
+#include "q.cpp"
+#include "tablebase.h"
+#include "tablebase.cpp"
+#include "checkpoint.h"
+#include "checkpoint.cpp"
+#include "gamebatch.h"
+#include "gamebatch.cpp"
+#include "train.h"
+#include "train.cpp"
+#include "policy.h"
+#include "policy.cpp"
+#include "search.h"
+#include "search.cpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * Benchmarks
+ *
+ * A standalone program timing the engine at three levels: micro (single
+ * Game / QLearner steps), macro (self-play games) and I/O (saving and
+ * loading tables). Every benchmark runs from a fixed seed and reports
+ * ns/op over many samples as percentiles, written as JSON and optionally
+ * compared against a baseline JSON from an earlier build.
+ */
+
+/**
+ * Options of a benchmark run
+ */
+struct BenchOptions {
+    // Seed of every benchmark's inputs
+    uint64_t seed = 0x5eed;
+    // Filter size of the learner benchmarks
+    int filter_size = 4;
+    // How the learner / I/O tables store rewards (QTable::VALUE_*)
+    uint32_t value_type = QTable::VALUE_FLOAT32;
+    // Timed samples per benchmark
+    int samples = 30;
+    // Table sizes of the I/O benchmarks, none to skip them
+    std::vector<long> io_states = {1000000, 10000000, 100000000};
+    // Table size of the update benchmarks, 0 to skip them
+    long update_states = 10000000;
+    // Updates per batch of the batched update benchmark
+    int update_batch = 4096;
+    // Directory the I/O benchmarks write to
+    std::string io_dir = ".";
+    // Only run benchmarks whose name contains this
+    std::string only = "";
+    // File to write the JSON results to, "" for stdout only
+    std::string json = "";
+    // JSON results of an earlier run to compare against, "" for none
+    std::string baseline = "";
+    // Allowed p50 slowdown over the baseline, percent
+    double tolerance = 10;
+};
+
+/**
+ * Timings of one benchmark, ns per op
+ */
+struct BenchResult {
+    std::string name;
+    // Ops per sample / samples taken
+    long ops;
+    int samples;
+    double min;
+    double mean;
+    double p50;
+    double p90;
+    double p99;
+};
+
+/**
+ * Learner benchmarks, a friend of QLearner<N> to time its private steps
+ */
+template <int N>
+struct QLearnerBench {
+    /**
+     * Time the learner's steps on random positions
+     * @param opts the run options
+     * @param results the timings are appended here
+     * @return void
+     */
+    static void micro(BenchOptions & opts, std::vector<BenchResult> & results);
+
+    /**
+     * Time updates between random states of a large table, applied at
+     * once and in sorted batches (QLearner::setUpdateBatch)
+     * @param opts the run options
+     * @param results the timings are appended here
+     * @return void
+     */
+    static void updates(BenchOptions & opts, std::vector<BenchResult> & results);
+};
+
+/**
+ * Parses the benchmark command line (--flag value pairs only)
+ * @param opts set from the flags given
+ * @return non-zero on an unknown flag or one missing its value
+ */
+int parseBenchArgs(int argc, char *argv[], BenchOptions & opts);
+
+/**
+ * Time an op: samples runs of ops calls of f(i), i counting up across
+ * runs. f should feed what it computes to bench_sink.
+ * @param name the benchmark name
+ * @param opts the run options (samples, only)
+ * @param ops calls per sample
+ * @param f the op
+ * @param results the timing is appended here unless skipped by only
+ * @return void
+ */
+template <typename F>
+void timeOps(std::string name, BenchOptions & opts, long ops, F f, std::vector<BenchResult> & results);
+
+/**
+ * Summarize sample timings as a result
+ * @param ns the ns/op of each sample
+ * @return the result with percentiles filled in
+ */
+BenchResult summarize(std::string name, long ops, std::vector<double> ns);
+
+/**
+ * Random positions reached by random legal play, from the seed
+ * @param count the number of positions
+ * @return the positions, none of them won or full
+ */
+std::vector<Game> randomPositions(uint64_t seed, int count);
+
+/**
+ * Game benchmarks: dropPiece, checkForWin, getBoard, a tablebase solve
+ * @return void
+ */
+void benchGame(BenchOptions & opts, std::vector<BenchResult> & results);
+
+/**
+ * Self-play games, as trainAI plays them
+ * @return void
+ */
+template <int N>
+void benchSelfPlay(BenchOptions & opts, std::vector<BenchResult> & results);
+
+/**
+ * Table save / load at each of opts.io_states, ns per state
+ * @return void
+ */
+template <int N>
+void benchIO(BenchOptions & opts, std::vector<BenchResult> & results);
+
+/**
+ * Run every benchmark for filter size N
+ * @return void
+ */
+template <int N>
+void runBenchmarks(BenchOptions & opts, std::vector<BenchResult> & results);
+
+/**
+ * Write results as JSON, one benchmark per line
+ * @return void
+ */
+void writeJSON(std::ostream & out, BenchOptions & opts, std::vector<BenchResult> & results);
+
+/**
+ * Compare results against a JSON baseline by p50
+ * @return the number of benchmarks slower than the tolerance allows,
+ * -1 if the baseline can't be read
+ */
+int compareBaseline(BenchOptions & opts, std::vector<BenchResult> & results);
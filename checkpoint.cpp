@@ -0,0 +1,179 @@
+#include "checkpoint.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/**
+ * Checkpointer class
+ *
+ * Periodic, non-blocking snapshots of training, see checkpoint.h.
+ */
+
+
+/**
+ * Checkpointer Constructor
+ * @param name the save name (no ext.) checkpoints are named after
+ * @param every_games games between checkpoints, 0 for no limit
+ * @param every_secs seconds between checkpoints, 0 for no limit
+ * @param keep the number of checkpoints kept on disk
+ * @param start_epoch the game training starts at
+ */
+Checkpointer::Checkpointer(std::string name, int every_games, int every_secs, int keep, int start_epoch) {
+    this->name = name;
+    this->every_games = every_games;
+    this->every_secs = every_secs;
+    this->keep = keep < 1 ? 1 : keep;
+    // a resumed run already has this snapshot
+    this->last_epoch = start_epoch;
+    this->last_time = std::chrono::steady_clock::now();
+    this->child = 0;
+}
+
+
+/**
+ * Start a checkpoint if one is due and the last has finished
+ * @return true if a checkpoint was started
+ */
+template <int N>
+bool Checkpointer::poll(int epoch, QLearner<N> * red, QLearner<N> * black, int red_wins, int ties) {
+    // reap the last writer without waiting, a slow one delays the next
+    if (this->child) {
+        if (waitpid(this->child, nullptr, WNOHANG) == 0) {
+            return false;
+        }
+        this->child = 0;
+    }
+
+    bool due = this->every_games && epoch - this->last_epoch >= this->every_games;
+    if (this->every_secs) {
+        std::chrono::duration<double> since = std::chrono::steady_clock::now() - this->last_time;
+        due = due || since.count() >= this->every_secs;
+    }
+    if (!due || epoch == this->last_epoch) {
+        return false;
+    }
+    this->last_epoch = epoch;
+    this->last_time = std::chrono::steady_clock::now();
+    red->flushUpdates();
+    black->flushUpdates();
+
+    // the child sees the tables as of now (copy on write) and writes them
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid == 0) {
+        _exit(write(epoch, red, black, red_wins, ties));
+    }
+    if (pid < 0) {
+        // can't fork, write in place instead
+        write(epoch, red, black, red_wins, ties);
+        return true;
+    }
+    this->child = pid;
+    return true;
+}
+
+
+/**
+ * Wait for a checkpoint in progress to be written
+ * @return void
+ */
+void Checkpointer::finish() {
+    if (this->child) {
+        waitpid(this->child, nullptr, 0);
+        this->child = 0;
+    }
+}
+
+
+/**
+ * Write a checkpoint and delete all but the newest keep
+ * @return 0 on success
+ */
+template <int N>
+int Checkpointer::write(int epoch, QLearner<N> * red, QLearner<N> * black, int red_wins, int ties) {
+    // red's header: epoch then red's run state, black's: its run state
+    // then the win/tie counts
+    uint64_t red_meta[4];
+    uint64_t black_meta[4];
+    red_meta[0] = epoch;
+    red->getRunState(red_meta + 1);
+    black->getRunState(black_meta);
+    black_meta[3] = ((uint64_t) red_wins << 32) | (uint32_t) ties;
+
+    // black first, the red file marks the checkpoint complete
+    if (black->getTable()->save(path(this->name, epoch, true), QLearner<N>::HASH_SCHEME, black_meta) < 0 ||
+        red->getTable()->save(path(this->name, epoch, false), QLearner<N>::HASH_SCHEME, red_meta) < 0) {
+        return 1;
+    }
+
+    std::vector<int> done = epochs(this->name);
+    for (size_t i = 0; i + this->keep < done.size(); i++) {
+        remove(path(this->name, done[i], false).c_str());
+        remove(path(this->name, done[i], true).c_str());
+    }
+    return 0;
+}
+
+
+/**
+ * Load the newest complete checkpoint of a save name
+ * @return the epoch to resume from, -1 if there is no checkpoint
+ */
+template <int N>
+int Checkpointer::resume(std::string name, QLearner<N> * red, QLearner<N> * black, int & red_wins, int & ties) {
+    std::vector<int> done = epochs(name);
+    // newest first, falling back if one can't be read
+    for (int i = (int) done.size() - 1; i >= 0; i--) {
+        uint64_t red_meta[4];
+        uint64_t black_meta[4];
+        if (red->getTable()->load(path(name, done[i], false), QLearner<N>::HASH_SCHEME, red_meta) < 0 ||
+            black->getTable()->load(path(name, done[i], true), QLearner<N>::HASH_SCHEME, black_meta) < 0) {
+            continue;
+        }
+        red->setRunState(red_meta + 1);
+        black->setRunState(black_meta);
+        red_wins = (int) (black_meta[3] >> 32);
+        ties = (int) (uint32_t) black_meta[3];
+        return (int) red_meta[0];
+    }
+    return -1;
+}
+
+
+/**
+ * File name of the red or black table of a checkpoint
+ */
+std::string Checkpointer::path(std::string name, int epoch, bool black) {
+    return name + ".ckpt." + std::to_string(epoch) + (black ? ".black.qtab" : ".qtab");
+}
+
+
+/**
+ * Epochs of the complete checkpoints on disk, oldest first
+ */
+std::vector<int> Checkpointer::epochs(std::string name) {
+    namespace fs = std::filesystem;
+    fs::path base(name + ".ckpt.");
+    fs::path dir = base.parent_path().empty() ? fs::path(".") : base.parent_path();
+    std::string prefix = base.filename().string();
+
+    std::vector<int> found;
+    std::error_code err;
+    for (const fs::directory_entry & entry : fs::directory_iterator(dir, err)) {
+        std::string file = entry.path().filename().string();
+        // NAME.ckpt.EPOCH.qtab only, not the black tables or .tmp files
+        if (file.compare(0, prefix.size(), prefix) != 0) {
+            continue;
+        }
+        std::string rest = file.substr(prefix.size());
+        size_t digits = rest.find_first_not_of("0123456789");
+        if (digits == 0 || digits == std::string::npos || rest.substr(digits) != ".qtab") {
+            continue;
+        }
+        found.push_back(std::stoi(rest.substr(0, digits)));
+    }
+    std::sort(found.begin(), found.end());
+    return found;
+}
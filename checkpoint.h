@@ -0,0 +1,98 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include "q.h"
+
+
+/**
+ * Checkpointer class
+ *
+ * A Checkpointer snapshots training every n games and/or t seconds
+ * without pausing it: the process forks, and the child writes its copy
+ * on write view of both Q tables while the parent keeps playing.
+ *
+ * A checkpoint is NAME.ckpt.EPOCH.black.qtab then NAME.ckpt.EPOCH.qtab
+ * (red, the trained AI, written last so its presence marks a complete
+ * checkpoint), each through a rename. The table headers hold the epoch,
+ * both learners' run states (see QLearner::getRunState) and the win/tie
+ * counts, so training resumes exactly. The newest keep checkpoints are kept.
+ */
+
+class Checkpointer {
+    public:
+        /**
+         * Checkpointer Constructor
+         * @param name the save name (no ext.) checkpoints are named after
+         * @param every_games games between checkpoints, 0 for no limit
+         * @param every_secs seconds between checkpoints, 0 for no limit
+         * @param keep the number of checkpoints kept on disk
+         * @param start_epoch the game training starts at (resumed from),
+         * the first checkpoint comes an interval after it
+         */
+        Checkpointer(std::string name, int every_games, int every_secs, int keep, int start_epoch = 0);
+
+        /**
+         * Start a checkpoint if one is due and the last has finished.
+         * Call between games. Buffered updates are applied first.
+         * @param epoch the number of games played
+         * @param red the trained AI
+         * @param black the opponent AI
+         * @param red_wins red's wins so far
+         * @param ties ties so far
+         * @return true if a checkpoint was started
+         */
+        template <int N>
+        bool poll(int epoch, QLearner<N> * red, QLearner<N> * black, int red_wins, int ties);
+
+        /**
+         * Wait for a checkpoint in progress to be written
+         * @return void
+         */
+        void finish();
+
+        /**
+         * Load the newest complete checkpoint of a save name
+         * @param name the save name (no ext.)
+         * @param red the trained AI, gets the red table and random state
+         * @param black the opponent AI, gets the black table and random state
+         * @param red_wins set to red's wins when saved
+         * @param ties set to the ties when saved
+         * @return the epoch to resume from, -1 if there is no checkpoint
+         */
+        template <int N>
+        static int resume(std::string name, QLearner<N> * red, QLearner<N> * black, int & red_wins, int & ties);
+
+    private:
+        // The save name checkpoints are named after
+        std::string name;
+        // Games / seconds between checkpoints (0 off)
+        int every_games;
+        int every_secs;
+        // Checkpoints kept on disk
+        int keep;
+        // Epoch and time of the last checkpoint started
+        int last_epoch;
+        std::chrono::steady_clock::time_point last_time;
+        // The writer process, 0 if none is running
+        pid_t child;
+
+        /**
+         * File name of the red or black table of a checkpoint
+         */
+        static std::string path(std::string name, int epoch, bool black);
+
+        /**
+         * Epochs of the complete checkpoints on disk, oldest first
+         */
+        static std::vector<int> epochs(std::string name);
+
+        /**
+         * Write a checkpoint (runs in the child) and delete old ones
+         * @return 0 on success
+         */
+        template <int N>
+        int write(int epoch, QLearner<N> * red, QLearner<N> * black, int red_wins, int ties);
+};
@@ -0,0 +1,180 @@
+#include "concurrent_qtable.h"
+
+/**
+ * ConcurrentQTable class
+ *
+ * A lock-free, fixed-capacity Q table, see concurrent_qtable.h.
+ */
+
+
+// Slots probed before a key is given up on, keeps a nearly full table
+// from scanning
+static const size_t MAX_PROBE = 256;
+
+
+/**
+ * ConcurrentQTable Constructor
+ * @param width the number of rewards stored per state
+ * @param capacity the number of states it can hold
+ */
+ConcurrentQTable::ConcurrentQTable(int width, size_t capacity) {
+    this->w = width;
+    this->bits = 4;
+    while ((1ULL << this->bits) < capacity) {
+        this->bits++;
+    }
+    size_t slots = 1ULL << this->bits;
+    this->mask = slots - 1;
+    this->keys.reset(new std::atomic<uint64_t>[slots]);
+    this->values.reset(new std::atomic<float>[slots * width]);
+    for (size_t i = 0; i < slots; i++) {
+        this->keys[i].store(EMPTY_KEY, std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < slots * width; i++) {
+        this->values[i].store(0, std::memory_order_relaxed);
+    }
+    this->ct_cas_retries = 0;
+    this->ct_insert_races = 0;
+    this->ct_insert_failures = 0;
+}
+
+
+/**
+ * Home slot of a key (fibonacci hashing, as QTable)
+ */
+size_t ConcurrentQTable::home(uint64_t key) {
+    return (size_t) ((key * 0x9e3779b97f4a7c15ULL) >> (64 - this->bits));
+}
+
+
+/**
+ * Find the rewards for a state
+ * @param key the state key
+ * @return the state's rewards, nullptr if not present
+ */
+std::atomic<float> * ConcurrentQTable::find(uint64_t key) {
+    size_t slot = home(key);
+    for (size_t probe = 0; probe < MAX_PROBE; probe++, slot = (slot + 1) & this->mask) {
+        uint64_t resident = this->keys[slot].load(std::memory_order_acquire);
+        if (resident == key) {
+            return &this->values[slot * this->w];
+        }
+        if (resident == EMPTY_KEY) {
+            return nullptr;
+        }
+    }
+    return nullptr;
+}
+
+
+/**
+ * Find the rewards for a state, inserting it if absent
+ * @param key the state key
+ * @param init the reward every action of a new state starts at
+ * @return the state's rewards, nullptr if the table is full
+ */
+std::atomic<float> * ConcurrentQTable::findOrInsert(uint64_t key, float init) {
+    size_t slot = home(key);
+    for (size_t probe = 0; probe < MAX_PROBE; probe++, slot = (slot + 1) & this->mask) {
+        uint64_t resident = this->keys[slot].load(std::memory_order_acquire);
+        if (resident == EMPTY_KEY) {
+            // claim the slot, or see who beat us to it
+            if (this->keys[slot].compare_exchange_strong(resident, key, std::memory_order_acq_rel)) {
+                std::atomic<float> * rewards = &this->values[slot * this->w];
+                for (int i = 0; i < this->w; i++) {
+                    rewards[i].store(init, std::memory_order_relaxed);
+                }
+                return rewards;
+            }
+            this->ct_insert_races.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (resident == key) {
+            return &this->values[slot * this->w];
+        }
+    }
+    this->ct_insert_failures.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+}
+
+
+/**
+ * Atomically add to a reward
+ * @param reward a reward from find / findOrInsert
+ * @param delta the amount to add
+ * @return void
+ */
+void ConcurrentQTable::add(std::atomic<float> * reward, float delta) {
+    float old = reward->load(std::memory_order_relaxed);
+    while (!reward->compare_exchange_weak(old, old + delta, std::memory_order_relaxed)) {
+        this->ct_cas_retries.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+
+/**
+ * Copy every state of a table in (not thread safe)
+ * @return void
+ */
+void ConcurrentQTable::copyFrom(QTable * table) {
+    table->forEach([&](uint64_t key, void * rewards) {
+        std::atomic<float> * dest = findOrInsert(key, 0);
+        for (int i = 0; dest && i < this->w; i++) {
+            dest[i].store(table->get(rewards, i), std::memory_order_relaxed);
+        }
+    });
+}
+
+
+/**
+ * Copy every state out into a table (not thread safe)
+ * @return void
+ */
+void ConcurrentQTable::copyTo(QTable * table) {
+    for (size_t slot = 0; slot <= this->mask; slot++) {
+        uint64_t key = this->keys[slot].load(std::memory_order_relaxed);
+        if (key == EMPTY_KEY) {
+            continue;
+        }
+        bool inserted;
+        void * dest = table->findOrInsert(key, inserted);
+        for (int i = 0; i < this->w; i++) {
+            table->set(dest, i, this->values[slot * this->w + i].load(std::memory_order_relaxed));
+        }
+    }
+}
+
+
+size_t ConcurrentQTable::size() {
+    size_t n = 0;
+    for (size_t slot = 0; slot <= this->mask; slot++) {
+        if (this->keys[slot].load(std::memory_order_relaxed) != EMPTY_KEY) {
+            n++;
+        }
+    }
+    return n;
+}
+
+
+size_t ConcurrentQTable::bytes() {
+    return (this->mask + 1) * (sizeof(uint64_t) + this->w * sizeof(float));
+}
+
+
+int ConcurrentQTable::width() {
+    return this->w;
+}
+
+
+long ConcurrentQTable::casRetries() {
+    return this->ct_cas_retries;
+}
+
+
+long ConcurrentQTable::insertRaces() {
+    return this->ct_insert_races;
+}
+
+
+long ConcurrentQTable::insertFailures() {
+    return this->ct_insert_failures;
+}
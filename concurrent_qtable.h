@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include "qtable.h"
+
+
+/**
+ * ConcurrentQTable class
+ *
+ * A fixed-capacity Q table many threads can read, insert into and update
+ * at once with no lock. Keys are claimed with a CAS on an empty slot
+ * (linear probing, entries never move) and rewards are atomic floats
+ * updated with CAS loops, Hogwild style: a state just claimed by another
+ * thread may be read before its rewards are initialized.
+ *
+ * The table never grows, findOrInsert returns nullptr once a key's probe
+ * run is full. Contention is counted: CAS retries on rewards, lost races
+ * for a slot, and inserts refused.
+ */
+
+class ConcurrentQTable {
+    public:
+        // Reserved key marking an empty slot, as in QTable
+        static constexpr uint64_t EMPTY_KEY = QTable::EMPTY_KEY;
+
+        /**
+         * ConcurrentQTable Constructor
+         * @param width the number of rewards stored per state
+         * @param capacity the number of states it can hold (rounded up to
+         * a power of two)
+         */
+        ConcurrentQTable(int width, size_t capacity);
+
+        /**
+         * Find the rewards for a state
+         * @param key the state key
+         * @return the state's rewards, nullptr if not present
+         */
+        std::atomic<float> * find(uint64_t key);
+
+        /**
+         * Find the rewards for a state, inserting it if absent
+         * @param key the state key
+         * @param init the reward every action of a new state starts at
+         * @return the state's rewards, nullptr if the table is full
+         */
+        std::atomic<float> * findOrInsert(uint64_t key, float init);
+
+        /**
+         * Atomically add to a reward
+         * @param reward a reward from find / findOrInsert
+         * @param delta the amount to add
+         * @return void
+         */
+        void add(std::atomic<float> * reward, float delta);
+
+        /**
+         * Copy every state of a table in (not thread safe)
+         * @return void
+         */
+        void copyFrom(QTable * table);
+
+        /**
+         * Copy every state out into a table (not thread safe), rewards
+         * saturate if the table stores 16-bit values
+         * @return void
+         */
+        void copyTo(QTable * table);
+
+        /**
+         * @return the number of states held (a scan, for reporting)
+         */
+        size_t size();
+
+        /**
+         * @return the bytes allocated for keys and rewards
+         */
+        size_t bytes();
+
+        /**
+         * @return the number of rewards per state
+         */
+        int width();
+
+        // Contention counters
+        long casRetries();
+        long insertRaces();
+        long insertFailures();
+
+    private:
+        // State keys, EMPTY_KEY when free
+        std::unique_ptr<std::atomic<uint64_t>[]> keys;
+        // Rewards, width per slot
+        std::unique_ptr<std::atomic<float>[]> values;
+        // Slot count - 1
+        size_t mask;
+        // log2 of the slot count
+        int bits;
+        // Rewards per state
+        int w;
+        // CAS loops that had to retry a reward update
+        std::atomic<long> ct_cas_retries;
+        // Slot claims lost to another thread
+        std::atomic<long> ct_insert_races;
+        // Inserts refused for a full probe run
+        std::atomic<long> ct_insert_failures;
+
+        /**
+         * Home slot of a key
+         */
+        size_t home(uint64_t key);
+};
@@ -3,53 +3,253 @@
 /**
  * Enter here.
  * Takes command line arguments:
- * [EPOCHS] [FILTER SIZE] [opt. LOAD/SAVE FNAME (no ext.)]
+ * [EPOCHS] [FILTER SIZE] [opt. LOAD/SAVE FNAME (no ext.)] [opt. flags]
+ * or, to rank saved tables against each other:
+ * [FILTER SIZE] --tournament T1,T2,... [opt. flags]
+ * or, to answer moves from a saved table over a Unix domain socket:
+ * [FILTER SIZE] [TABLE] --serve SOCKET [opt. flags]
+ * --checkpoint-games N  checkpoint every N games (needs FNAME)
+ * --checkpoint-secs T   checkpoint every T seconds (needs FNAME)
+ * --keep-checkpoints K  checkpoints kept on disk (default 3)
+ * --resume              continue from FNAME's newest checkpoint
+ * --threads N           self-play on N threads (default 1)
+ * --sync-games G        games per thread between table merges (default 1000)
+ * --merge sum|avg       how merges combine updates to a state (default avg)
+ * --shared-table        threads train one lock-free table instead of merging
+ * --table-states N      states the shared table can hold (default 4M)
+ * --batch N             play N games in lockstep on one thread (default off)
+ * --telemetry FILE      stream training counters to FILE
+ * --telemetry-games G   games per telemetry row (default 1000)
+ * --telemetry-format F  jsonl or csv (default csv for a .csv FILE, else jsonl)
+ * --values TYPE         store rewards as f32, or 16-bit i16 / f16 (default f32)
+ * --max-table-bytes B   cap each AI's Q table at B bytes (K/M/G suffix), evicting
+ *                       rarely visited states once full
+ * --update-batch U      apply Q updates U at a time in table order (default 0,
+ *                       each at once)
+ * --tournament T1,...   play the tables (.qtab added if missing) round-robin,
+ *                       printing win rates and Elo ratings (--threads, --values
+ *                       apply, default threads: one per core)
+ * --games M             tournament games per pair of tables (default 100)
+ * --opening-moves P     random plies opening each tournament game pair (default 4)
+ * --seed S              seed of the tournament openings (default 1)
+ * --serve SOCKET        serve TABLE's moves on SOCKET until SIGINT/SIGTERM
+ *                       (--threads, --values apply, default threads: one per core)
+ * --serve-batch B       requests answered per server thread wakeup (default 256)
+ * --report-secs T       seconds between server latency reports (default 10)
+ * --decision-cache E    cache tournament / server moves by position, E entries
+ *                       per table (default 0, off)
+ * --move-ms T           search each tournament / human match move for T ms
+ *                       (alpha-beta on the Q table, default 0: greedy)
+ * --tablebase FILE      end training games K cells from a full board on their
+ *                       exact result, solved or read from FILE (saved back
+ *                       after training; one game at a time training only)
+ * --tb-empty K          empty cells of the tablebase's positions (default 10)
  */
 int main(int argc, char *argv[]) {
     std::cout << " " << std::endl;
     srand(time(NULL));
 
     // Parse command line args
-    if (argc < 3 || argc > 4) {
+    std::vector<std::string> args;
+    std::map<std::string, std::string> flags;
+    int bad_args = parseArgs(argc, argv, args, flags, {"--resume", "--shared-table"});
+    bool tournament_mode = flags.count("--tournament");
+    bool serve_mode = flags.count("--serve");
+    if (bad_args ||
+        (tournament_mode ? args.size() != 1 : serve_mode ? args.size() != 2 : args.size() < 2 || args.size() > 3) ||
+        (flags.count("--values") && QTable::parseValueType(flags["--values"]) < 0) ||
+        (flags.count("--max-table-bytes") && !parseBytes(flags["--max-table-bytes"])) ||
+        (args.size() < 3 && (flags.count("--checkpoint-games") || flags.count("--checkpoint-secs") ||
+                             flags.count("--resume")))) {
         std::cout << "USAGE" << std::endl;
         std::cout << "[EPOCHS] [FILTER SIZE] [opt. LOAD/SAVE FNAME (no ext.)]" << std::endl;
+        std::cout << "  --checkpoint-games N --checkpoint-secs T --keep-checkpoints K --resume (need FNAME)" << std::endl;
+        std::cout << "  --threads N --sync-games G --merge sum|avg --shared-table --table-states N" << std::endl;
+        std::cout << "  --batch N --telemetry FILE --telemetry-games G --telemetry-format jsonl|csv" << std::endl;
+        std::cout << "  --values f32|i16|f16 --max-table-bytes B --update-batch U --move-ms T" << std::endl;
+        std::cout << "  --tablebase FILE --tb-empty K" << std::endl;
+        std::cout << "[FILTER SIZE] --tournament T1,T2,... --games M --opening-moves P --seed S --decision-cache E --move-ms T" << std::endl;
+        std::cout << "[FILTER SIZE] [TABLE] --serve SOCKET --serve-batch B --report-secs T --decision-cache E" << std::endl;
         return 0;
     }
-    int n_epochs = atoi(argv[1]);
-    int filter_size = atoi(argv[2]);
+    if (serve_mode) {
+        switch (atoi(args[0].c_str())) {
+            case 3: return serve<3>(args[1], flags);
+            case 4: return serve<4>(args[1], flags);
+            case 5: return serve<5>(args[1], flags);
+            case 6: return serve<6>(args[1], flags);
+        }
+        std::cout << "\033[1;31mFILTER SIZE MUST BE 3-6\033[0m" << std::endl;
+        return 1;
+    }
+    if (tournament_mode) {
+        switch (atoi(args[0].c_str())) {
+            case 3: return tournament<3>(flags);
+            case 4: return tournament<4>(flags);
+            case 5: return tournament<5>(flags);
+            case 6: return tournament<6>(flags);
+        }
+        std::cout << "\033[1;31mFILTER SIZE MUST BE 3-6\033[0m" << std::endl;
+        return 1;
+    }
+    // each filter size is its own compiled learner
+    switch (atoi(args[1].c_str())) {
+        case 3: return trainAndPlay<3>(args, flags);
+        case 4: return trainAndPlay<4>(args, flags);
+        case 5: return trainAndPlay<5>(args, flags);
+        case 6: return trainAndPlay<6>(args, flags);
+    }
+    std::cout << "\033[1;31mFILTER SIZE MUST BE 3-6\033[0m" << std::endl;
+    return 1;
+}
 
 
+/**
+ * Trains, saves and plays the AI of filter size N (the body of main, one
+ * instantiation per filter size)
+ * @param args the positional command line args
+ * @param flags the command line flags
+ * @return the exit code
+ */
+template <int N>
+int trainAndPlay(std::vector<std::string> & args, std::map<std::string, std::string> & flags) {
+    int n_epochs = atoi(args[0].c_str());
+
     // The game object the Qs will play on
     Game * game = new Game();
 
-    // Init two AI
-    QLearner * AI = new QLearner(game, 0.1, 4, 1, filter_size);
-    QLearner * OPP_AI = new QLearner(game, 0.1, 2, -1, filter_size);
+    // Init two AI, their tables storing rewards as --values gives
+    uint32_t value_type = flags.count("--values") ? QTable::parseValueType(flags["--values"]) : QTable::VALUE_FLOAT32;
+    QLearner<N> * AI = new QLearner<N>(game, 0.1, 4, 1, value_type);
+    QLearner<N> * OPP_AI = new QLearner<N>(game, 0.1, 2, -1, value_type);
+    size_t max_table_bytes = flags.count("--max-table-bytes") ? parseBytes(flags["--max-table-bytes"]) : 0;
+    AI->getTable()->setMaxBytes(max_table_bytes);
+    OPP_AI->getTable()->setMaxBytes(max_table_bytes);
+    int update_batch = flags.count("--update-batch") ? atoi(flags["--update-batch"].c_str()) : 0;
+    AI->setUpdateBatch(update_batch);
+    OPP_AI->setUpdateBatch(update_batch);
 
 
     // load data for main AI if applicable
     std::string fname = "";
-    if (argc == 4) {
-        fname = argv[3];
-        fname += ".txt";
-        AI->loadQ(fname);
+    TrainOptions opts;
+    if (args.size() == 3) {
+        fname = args[2];
+        if (flags.count("--resume")) {
+            opts.start_epoch = Checkpointer::resume(fname, AI, OPP_AI, opts.red_wins, opts.ties);
+            if (opts.start_epoch < 0) {
+                std::cout << "\033[1;31mNO CHECKPOINT FOR " << fname << "\033[0m" << std::endl;
+                return 1;
+            }
+            std::cout << "\033[1;32mRESUMED: \033[0mgame " << opts.start_epoch << std::endl;
+        // a missing file starts fresh, an incompatible one is never overwritten
+        } else if (AI->loadQ(fname + ".qtab") == -2) {
+            return 1;
+        }
+    }
+    Checkpointer * checkpointer = nullptr;
+    if (flags.count("--checkpoint-games") || flags.count("--checkpoint-secs")) {
+        int keep = flags.count("--keep-checkpoints") ? atoi(flags["--keep-checkpoints"].c_str()) : 3;
+        checkpointer = new Checkpointer(fname, atoi(flags["--checkpoint-games"].c_str()),
+                                        atoi(flags["--checkpoint-secs"].c_str()), keep, opts.start_epoch);
+        opts.checkpointer = checkpointer;
+    }
+    Telemetry * telemetry = nullptr;
+    if (flags.count("--telemetry")) {
+        std::string tname = flags["--telemetry"];
+        bool csv = flags.count("--telemetry-format") ? flags["--telemetry-format"] == "csv" :
+                   tname.size() > 4 && tname.compare(tname.size() - 4, 4, ".csv") == 0;
+        int every = flags.count("--telemetry-games") ? atoi(flags["--telemetry-games"].c_str()) : 1000;
+        telemetry = new Telemetry(tname, csv, every);
+        if (!telemetry->isOpen()) {
+            std::cout << "\033[1;31mCAN'T WRITE TELEMETRY TO " << tname << "\033[0m" << std::endl;
+            return 1;
+        }
+        AI->setTelemetry(telemetry);
+        OPP_AI->setTelemetry(telemetry);
+        opts.telemetry = telemetry;
+    }
+
+    Tablebase * tablebase = nullptr;
+    int n_threads = flags.count("--threads") ? atoi(flags["--threads"].c_str()) : 1;
+    if (flags.count("--tablebase")) {
+        int empty = flags.count("--tb-empty") ? atoi(flags["--tb-empty"].c_str()) : 10;
+        tablebase = new Tablebase(std::min(std::max(empty, 1), 41));
+        // a missing file starts empty, an incompatible one is never overwritten
+        long loaded = tablebase->load(flags["--tablebase"]);
+        if (loaded == -2) {
+            return 1;
+        }
+        if (loaded >= 0) {
+            std::cout << "\033[1;32mLOADED: \033[0m" << loaded << " solved positions from\033[1;32m ";
+            std::cout << flags["--tablebase"] << "\033[0m" << std::endl;
+        }
+        if (n_threads > 1 || flags.count("--batch")) {
+            std::cout << "\033[1;31mTHE TABLEBASE IS NOT USED WITH --threads OR --batch\033[0m" << std::endl;
+        }
+        opts.tablebase = tablebase;
     }
 
     // start training our two AI against one another
     std::cout << "\033[1;36mSTART TRAINING\033[0m" << std::endl;
-    trainAI(AI, OPP_AI, game, n_epochs);
+    if (n_threads > 1) {
+        int sync_games = flags.count("--sync-games") ? atoi(flags["--sync-games"].c_str()) : 1000;
+        bool average = !flags.count("--merge") || flags["--merge"] != "sum";
+        ConcurrentQTable * shared = nullptr;
+        if (flags.count("--shared-table")) {
+            size_t states = flags.count("--table-states") ? atol(flags["--table-states"].c_str()) : (1 << 22);
+            shared = new ConcurrentQTable(N, std::max(states, 2 * AI->getTable()->size()));
+        }
+        if (telemetry) {
+            std::cout << "\033[1;31mTELEMETRY IS NOT TAKEN WITH --threads\033[0m" << std::endl;
+        }
+        trainParallel(AI, OPP_AI, n_epochs, n_threads, sync_games, average, shared, opts);
+        delete shared;
+    } else if (flags.count("--batch")) {
+        trainBatch(AI, OPP_AI, n_epochs, std::max(1, atoi(flags["--batch"].c_str())), opts);
+    } else {
+        trainAI(AI, OPP_AI, game, n_epochs, opts);
+    }
+    if (checkpointer) {
+        checkpointer->finish();
+    }
+    if (telemetry) {
+        AI->setTelemetry(nullptr);
+        OPP_AI->setTelemetry(nullptr);
+        delete telemetry;
+    }
+    if (tablebase) {
+        long ended = tablebase->probes();
+        std::cout << "\033[1;36mTABLEBASE: \033[0m" << ended << " games ended " << tablebase->empty();
+        std::cout << " cells from a full board, " << ended - tablebase->solves() << " known and ";
+        std::cout << tablebase->solves() << " solved" << std::endl;
+        if (tablebase->save(flags["--tablebase"]) < 0) {
+            std::cout << "\033[1;31mCAN'T WRITE " << flags["--tablebase"] << "\033[0m" << std::endl;
+        }
+        delete tablebase;
+    }
+    if (max_table_bytes) {
+        QTable * tables[2] = {AI->getTable(), OPP_AI->getTable()};
+        for (int t = 0; t < 2; t++) {
+            std::cout << "\033[1;36m" << (t ? "BLACK" : "RED") << " TABLE: \033[0m" << tables[t]->size() << " states, ";
+            std::cout << tables[t]->bytes() << " of " << max_table_bytes << " bytes (";
+            std::cout << (int) (100.0 * tables[t]->bytes() / max_table_bytes) << "%), ";
+            std::cout << tables[t]->evictions() << " evicted" << std::endl;
+        }
+    }
 
-    if (argc == 4) {
-        AI->saveQ(fname);
+    if (args.size() == 3) {
+        AI->saveQ(fname + ".qtab");
     }
 
     // Human v Bot gameplay loop
+    int move_ms = flags.count("--move-ms") ? atoi(flags["--move-ms"].c_str()) : 0;
     while (true) {
         std::cout << std::endl << "\033[1;7;4;36m hit p to play \033[0m"  << std::endl;
         char input = 0;
         std::cin >> input;
         if (input == 'p') {
-            humanMatch(AI, game);
+            humanMatch(AI, game, move_ms);
         } else {
             break;
         }
@@ -60,112 +260,196 @@ int main(int argc, char *argv[]) {
 
 
 /**
- * Trains two given AI against one another in a given Game.
- * @param red the winner AI (moves first)
- * @param black the loser AI (moves second)
- * @param game the Game obj. that the two AIs are playing in
- * @param n_epochs total number of epochs to train for
- * @return non-zero on error
+ * Loads the tables given to --tournament and plays them round-robin
+ * @param flags the command line flags
+ * @return the exit code
  */
-int trainAI(QLearner * red, QLearner * black, Game * game, int n_epochs) {
-    clock_t begin_time = clock();
-    int red_wins = 0;
-    int ties = 0;
-    // how often to print info
-    int info_epochs = 1000;
-
-    // Play n_epochs matches in training mode
-    for (int i = 0; i < n_epochs; i++) {
-
-        // Small tool for tracking speed and progress of training
-        if (i % info_epochs == 0 && i != 0) {
-            float t = float( clock () - begin_time ) /  CLOCKS_PER_SEC;
-            std::cout << "\r\033[1;36mGAME: " << i << "/" << n_epochs << " games/sec: " <<(int)(info_epochs / t)<< "\033[0m" << std::flush;
-            begin_time = clock();
-        }
-
-        // Play until a win or full board
-        int current_turn = 0;
-        while (true) {
-            // take turns of two players dropping a piece / checking status
-            // red moves first then update board
-            current_turn++;
-
-            size_t curr_board_hash = game->getBoard();
-            int move = red->makeMove(true);
-
-            // only check after win is possibe, save a little time
-            int winner = 0;
-            if (current_turn > 8) {
-                winner = game->checkForWin();
-            }
-
-            // update Q tables of red and black
-            red->update(winner, -1, move, curr_board_hash);
-
-            game->dropPiece(move, 1);
+template <int N>
+int tournament(std::map<std::string, std::string> & flags) {
+    uint32_t value_type = flags.count("--values") ? QTable::parseValueType(flags["--values"]) : QTable::VALUE_FLOAT32;
+    std::vector<std::string> names;
+    std::stringstream list(flags["--tournament"]);
+    for (std::string name; std::getline(list, name, ',');) {
+        if (!name.empty()) {
+            names.push_back(name);
+        }
+    }
+    if (names.size() < 2) {
+        std::cout << "\033[1;31mA TOURNAMENT NEEDS AT LEAST 2 TABLES\033[0m" << std::endl;
+        return 1;
+    }
 
-            // update board to represent the current state
-            curr_board_hash = game->getBoard();
+    // each table is only read, by every worker thread at once
+    size_t cache_entries = flags.count("--decision-cache") ? atol(flags["--decision-cache"].c_str()) : 0;
+    std::vector<QPolicy<N> *> players;
+    for (std::string & name : names) {
+        std::string fname = name;
+        if (fname.size() < 5 || fname.compare(fname.size() - 5, 5, ".qtab") != 0) {
+            fname += ".qtab";
+        }
+        QPolicy<N> * player = new QPolicy<N>(value_type);
+        int loaded = player->loadQ(fname);
+        if (loaded == -1) {
+            std::cout << "\033[1;31mCAN'T OPEN " << fname << "\033[0m" << std::endl;
+        }
+        if (loaded) {
+            return 1;
+        }
+        player->setCache(cache_entries);
+        players.push_back(player);
+    }
 
-            // iff there is no winner, black makes it's move then update board
-            if (!winner && !game->boardIsFull()) {
-                int move = black->makeMove(true);
-                if (current_turn > 8) {
-                    winner = game->checkForWin();
-                }
+    TournamentOptions opts;
+    opts.n_threads = flags.count("--threads") ? atoi(flags["--threads"].c_str()) :
+                     std::max(1, (int) std::thread::hardware_concurrency());
+    if (flags.count("--games")) {
+        opts.games_per_pair = atoi(flags["--games"].c_str());
+    }
+    if (flags.count("--opening-moves")) {
+        opts.opening_moves = std::min(std::max(atoi(flags["--opening-moves"].c_str()), 0), 6);
+    }
+    if (flags.count("--seed")) {
+        opts.seed = strtoull(flags["--seed"].c_str(), nullptr, 10);
+    }
+    if (flags.count("--move-ms")) {
+        opts.move_ms = std::max(atoi(flags["--move-ms"].c_str()), 0);
+    }
+    TournamentResults results;
+    if (playTournament(players, opts, results)) {
+        std::cout << "\033[1;31mBAD TOURNAMENT SIZE\033[0m" << std::endl;
+        return 1;
+    }
+    long n_games = (long) names.size() * (names.size() - 1) / 2 * opts.games_per_pair;
+    std::cout << "\033[1;36mTOURNAMENT: \033[0m" << names.size() << " tables, " << n_games << " games on ";
+    std::cout << std::max(1, opts.n_threads) << " threads in " << results.secs << "s (";
+    std::cout << (long) (n_games / std::max(results.secs, 1e-9)) << " games/sec, " << results.steals << " stolen)" << std::endl;
+    if (results.search.moves) {
+        SearchTotals & search = results.search;
+        std::cout << "\033[1;36mSEARCH: \033[0m" << search.moves << " moves, depth " << (double) search.depths / search.moves;
+        std::cout << " on average (" << search.max_depth << " deepest), ";
+        std::cout << (long) (search.nodes / std::max(search.secs, 1e-9)) << " nodes/sec" << std::endl;
+    }
+    printTournament(names, results);
+    for (QPolicy<N> * player : players) {
+        delete player;
+    }
+    return 0;
+}
 
-                // update Q tables of red and black
-                black->update(winner, 1, move, curr_board_hash);
 
-                game->dropPiece(move, -1);
+/**
+ * Loads a table and serves its moves over a Unix domain socket until
+ * stopped
+ * @param fname the table to serve (.qtab added if missing)
+ * @param flags the command line flags
+ * @return the exit code
+ */
+template <int N>
+int serve(std::string fname, std::map<std::string, std::string> & flags) {
+    if (fname.size() < 5 || fname.compare(fname.size() - 5, 5, ".qtab") != 0) {
+        fname += ".qtab";
+    }
+    uint32_t value_type = flags.count("--values") ? QTable::parseValueType(flags["--values"]) : QTable::VALUE_FLOAT32;
+    QPolicy<N> policy(value_type);
+    int loaded = policy.loadQ(fname);
+    if (loaded == -1) {
+        std::cout << "\033[1;31mCAN'T OPEN " << fname << "\033[0m" << std::endl;
+    }
+    if (loaded) {
+        return 1;
+    }
+    policy.setCache(flags.count("--decision-cache") ? atol(flags["--decision-cache"].c_str()) : 0);
+    int n_threads = flags.count("--threads") ? atoi(flags["--threads"].c_str()) :
+                    std::max(1, (int) std::thread::hardware_concurrency());
+    int max_batch = flags.count("--serve-batch") ? atoi(flags["--serve-batch"].c_str()) : 256;
+    int report_secs = flags.count("--report-secs") ? atoi(flags["--report-secs"].c_str()) : 10;
+    MoveServer<N> server(&policy, flags["--serve"], n_threads, max_batch, report_secs);
+    return server.run() ? 1 : 0;
+}
 
-            }
 
-            // On win, record, reset, and restart - adjust Qs accordingly
-            if (winner) {
-                if (winner == 1) {
-                    red_wins++;
-                    black->updateLoss();
-                } else {
-                    red->updateLoss();
-                }
-                game->resetGame();
-                break;
-            } else if (game->boardIsFull()) {
-                ties++;
-                game->resetGame();
-                break;
-            }
+/**
+ * Splits command line args into positional args and --flag value pairs
+ * (a flag in bools takes no value)
+ * @param args set to the positional args
+ * @param flags set to the flags given, name (with --) to value
+ * @param bools the flags that take no value
+ * @return non-zero if a flag is missing its value
+ */
+int parseArgs(int argc, char *argv[], std::vector<std::string> & args,
+              std::map<std::string, std::string> & flags, std::vector<std::string> bools) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0) {
+            args.push_back(arg);
+        } else if (std::find(bools.begin(), bools.end(), arg) != bools.end()) {
+            flags[arg] = "1";
+        } else if (i + 1 < argc) {
+            flags[arg] = argv[++i];
+        } else {
+            return -1;
         }
-
     }
-    std::cout << std::endl<<"\033[1;36mSTOP TRAINING\033[0m";
-    std::cout << std::endl<<"\033[1;36m";
-    std::cout << red_wins << ":" << (n_epochs-red_wins) << ":" << ties;
-    std::cout << "\033[0m" << std::endl;
-
     return 0;
 }
 
 
+/**
+ * Parses a byte count with an optional K, M or G suffix (powers of 1024)
+ * @param text the count, e.g. 512M
+ * @return the bytes, 0 if text is not a count
+ */
+size_t parseBytes(std::string text) {
+    char * end = nullptr;
+    unsigned long long bytes = strtoull(text.c_str(), &end, 10);
+    if (end == text.c_str()) {
+        return 0;
+    }
+    std::string suffix = end;
+    const std::string units = "KMG";
+    if (suffix.size() == 1 && units.find(toupper(suffix[0])) != std::string::npos) {
+        bytes <<= 10 * (units.find(toupper(suffix[0])) + 1);
+    } else if (!suffix.empty()) {
+        return 0;
+    }
+    return (size_t) bytes;
+}
+
+
 /**
  * Allows manual playing against a QLearner AI object.
  * @param AI a QLearner AI, must be trained beforehand or will lose. Plays red.
  * @param game the Game obj. to play against the AI in.
+ * @param move_ms search each AI move this long, 0 for greedy moves
  * @return non-zero on error
  */
-int humanMatch(QLearner * AI, Game * game) {
+template <int N>
+int humanMatch(QLearner<N> * AI, Game * game, int move_ms) {
     int i = 0;
     std::string board_txt = "";
+    QPolicy<N> policy(AI);
+    QSearch<N> search(&policy);
     while(1) {
         i++;
         // play red (AI) move
-        int AI_move = AI->makeMove(false);
-        game->dropPiece(AI_move, -1);
-        int winner = game->checkForWin();
+        int AI_move;
+        SearchStats stats;
+        if (move_ms > 0) {
+            // the AI's pieces (-1) shown as player 1
+            AI_move = search.selectMove(game->getPosition() ^ game->getMask(), game->getMask(), move_ms, 42, &stats);
+        } else {
+            AI_move = AI->makeMove(false);
+        }
+        bool won = false;
+        game->dropPiece(AI_move, -1, won);
+        int winner = won ? -1 : 0;
         board_txt = game->printBoard();
-        AI->showRews();
+        if (move_ms > 0) {
+            std::cout << "\033[1;36mSEARCH: \033[0mdepth " << stats.depth << ", " << stats.nodes << " nodes, ";
+            std::cout << (long) (stats.nodes / std::max(stats.secs, 1e-9)) << " nodes/sec" << std::endl;
+        } else {
+            AI->showRews();
+        }
         std::cout << "\r" << board_txt << std::flush;
 
         // if red didn't win, it is blacks(user) move - get input, make move
@@ -178,8 +462,8 @@ int humanMatch(QLearner * AI, Game * game) {
                     std::cout << "pick valid move 1-7" << std::endl;
                     continue;
                 }
-                game->dropPiece(move-1, 1);
-                winner = game->checkForWin();
+                game->dropPiece(move-1, 1, won);
+                winner = won ? 1 : 0;
                 break;
             }
         }
@@ -1,26 +1,94 @@
 #pragma once
 
+#include "alloc_count.h"
 #include "game.h"
 #include "game.cpp"
 #include <iostream>
 #include "q.h"
+#include "telemetry.cpp"
+#include "qtable.cpp"
+#include "concurrent_qtable.cpp"
 #include "q.cpp"
+#include "tablebase.h"
+#include "tablebase.cpp"
+#include "checkpoint.h"
+#include "checkpoint.cpp"
+#include "gamebatch.h"
+#include "gamebatch.cpp"
+#include "train.h"
+#include "train.cpp"
+#include "policy.h"
+#include "policy.cpp"
+#include "search.h"
+#include "search.cpp"
 #include <ctime>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 
 /**
- * Trains two given AI against one another in a given Game.
- * @param red the winner AI (moves first)
- * @param black the loser AI (moves second)
- * @param game the Game obj. that the two AIs are playing in
- * @param n_epochs total number of epochs to train for
- * @return non-zero on error
+ * Splits command line args into positional args and --flag value pairs
+ * (a flag in bools takes no value)
+ * @param args set to the positional args
+ * @param flags set to the flags given, name (with --) to value
+ * @param bools the flags that take no value
+ * @return non-zero if a flag is missing its value
+ */
+int parseArgs(int argc, char *argv[], std::vector<std::string> & args,
+              std::map<std::string, std::string> & flags, std::vector<std::string> bools);
+
+/**
+ * Parses a byte count with an optional K, M or G suffix (powers of 1024)
+ * @param text the count, e.g. 512M
+ * @return the bytes, 0 if text is not a count
+ */
+size_t parseBytes(std::string text);
+
+/**
+ * Trains, saves and plays the AI of filter size N (the body of main, one
+ * instantiation per filter size)
+ * @param args the positional command line args
+ * @param flags the command line flags
+ * @return the exit code
  */
-int trainAI(QLearner * red, QLearner * black, Game * game, int n_epochs);
+template <int N>
+int trainAndPlay(std::vector<std::string> & args, std::map<std::string, std::string> & flags);
 
 /**
  * Allows manual playing against a QLearner AI object.
  * @param AI a QLearner AI, must be trained beforehand or will lose. Plays red.
  * @param game the Game obj. to play against the AI in.
+ * @param move_ms search each AI move this long, 0 for greedy moves
  * @return non-zero on error
  */
-int humanMatch(QLearner * AI, Game * game);
+template <int N>
+int humanMatch(QLearner<N> * AI, Game * game, int move_ms);
+
+/**
+ * Loads the tables given to --tournament and plays them round-robin
+ * (the body of main in tournament mode, one instantiation per filter size)
+ * @param flags the command line flags
+ * @return the exit code
+ */
+template <int N>
+int tournament(std::map<std::string, std::string> & flags);
+
+/**
+ * Loads a table and serves its moves over a Unix domain socket until
+ * stopped (the body of main in server mode, one instantiation per filter
+ * size)
+ * @param fname the table to serve (.qtab added if missing)
+ * @param flags the command line flags
+ * @return the exit code
+ */
+template <int N>
+int serve(std::string fname, std::map<std::string, std::string> & flags);
+
+#include "parallel.h"
+#include "parallel.cpp"
+#include "tournament.h"
+#include "tournament.cpp"
+#include "server.h"
+#include "server.cpp"
@@ -10,15 +10,33 @@
 
 
 /**
- * Game constructor
+ * Zobrist keys for each player / bitboard index, built at compile time
  */
-Game::Game() {
-    // init board to empty (0)
-    for (int i = 0; i < HEIGHT; i++) {
-        for (int j = 0; j < WIDTH; j++) {
-            board[i][j] = 0;
+struct ZobristKeys {
+    uint64_t keys[2][64];
+
+    constexpr ZobristKeys() : keys() {
+        uint64_t s = ZOBRIST_SEED;
+        for (int p = 0; p < 2; p++) {
+            for (int b = 0; b < 64; b++) {
+                // SplitMix64
+                s += 0x9e3779b97f4a7c15ULL;
+                uint64_t z = s;
+                z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+                z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+                keys[p][b] = z ^ (z >> 31);
+            }
         }
     }
+};
+static constexpr ZobristKeys ZOBRIST;
+
+
+/**
+ * Game constructor
+ */
+Game::Game() {
+    resetGame();
 }
 
 
@@ -27,6 +45,10 @@ Game::Game() {
 * @return void
 */
 void Game::resetGame() {
+    position = 0;
+    mask = 0;
+    key = 0;
+    mirror_key = 0;
     // reset all values to empty (0)
     for (int i = 0; i < HEIGHT; i++) {
         for (int j = 0; j < WIDTH; j++) {
@@ -38,32 +60,64 @@ void Game::resetGame() {
 
 
 /**
- * Hashes the current board uniquely for sake of Q learner
- * @return a unique hash of the board
+ * Hashes the current board for sake of Q learner, the same for a board
+ * and its left-right mirror. O(1) as the Zobrist keys of the board and
+ * its mirror are updated on each drop
+ * @return the smaller of the board's and its mirror's Zobrist keys
  */
 size_t Game::getBoard() {
-    // using builtin std::hash, hash any board to a representative size_t
-    std::hash<std::string> hash;
-    std::string s = "";
+    return key < mirror_key ? key : mirror_key;
+}
+
+/**
+ * Bitboard of player 1's pieces (layout as in the class doc)
+ * @return the player 1 bitboard
+ */
+uint64_t Game::getPosition() const {
+    return position;
+}
+
+
+/**
+ * Bitboard of every occupied cell (layout as in the class doc)
+ * @return the occupied bitboard
+ */
+uint64_t Game::getMask() const {
+    return mask;
+}
 
-    // Parse the board into a string of form s_00s_01...s_hw
-    for (int i = 0; i < HEIGHT; i++) {
-        for (int j = 0; j < WIDTH; j++) {
-            s += std::to_string(board[i][j]);
-        }
-    }
 
-    return hash(s);
+/**
+ * Set the board to a position given as bitboards, rebuilding the board
+ * view and Zobrist key. Other pieces are marked -1.
+ * @return void
+ */
+void Game::setPosition(uint64_t position, uint64_t mask) {
+    resetGame();
+    this->position = position;
+    this->mask = mask;
+    // visit each piece once, lowest bit first
+    for (uint64_t rest = mask; rest; rest &= rest - 1) {
+        int bit = __builtin_ctzll(rest);
+        int player = ((position >> bit) & 1) ? 1 : -1;
+        board[HEIGHT - 1 - bit % (HEIGHT + 1)][bit / (HEIGHT + 1)] = player;
+        key ^= ZOBRIST.keys[player == 1 ? 0 : 1][bit];
+        mirror_key ^= ZOBRIST.keys[player == 1 ? 0 : 1][mirrorBit(bit)];
+    }
 }
 
+
 int Game::populateBoardlike(int coord, int player, int (&new_)[6][7]) {
-    int y = dropPiece(coord, player);
     for (int i = 0; i < 6; i++) {
         for (int j = 0; j < 7; j++) {
             new_[i][j] = board[i][j];
         }
     }
-    board[y][coord] = 0;
+    // place the piece in the copy only, this board is left untouched
+    if (validMove(coord) == 0) {
+        int height = __builtin_popcountll(mask & columnMask(coord));
+        new_[HEIGHT - 1 - height][coord] = player;
+    }
     return 0;
 }
 
@@ -105,7 +159,7 @@ int Game::populateBoardlike(int coord, int player, int (&new_)[6][7]) {
  */
 int Game::validMove(int coord) {
     // A move is invalid if the column is full, or if the coord is invalid
-    if (coord < 0 || coord >= WIDTH || board[0][coord] != 0) {
+    if (coord < 0 || coord >= WIDTH || (mask & topMask(coord))) {
         return -1;
     }
     // else the move is valid / return
@@ -113,6 +167,30 @@ int Game::validMove(int coord) {
 }
 
 
+/**
+ * Every valid drop at once
+ * @return bit c set iff column c is not full
+ */
+uint32_t Game::legalMoves() const {
+    return legalMoves(mask);
+}
+
+
+/**
+ * Every valid drop of a position given as bitboards
+ * @return bit c set iff column c is not full
+ */
+uint32_t Game::legalMoves(uint64_t mask) {
+    // free top cells, one per column (HEIGHT + 1) bits apart
+    uint64_t open = ~mask & (bottomRow() << (HEIGHT - 1));
+    uint32_t legal = 0;
+    for (int j = 0; j < WIDTH; j++) {
+        legal |= (uint32_t) ((open >> (j * (HEIGHT + 1) + HEIGHT - 1)) & 1) << j;
+    }
+    return legal;
+}
+
+
 /**
  * Drops a piece into the board
  * @param coord the x-coordinate to drop from
@@ -125,31 +203,69 @@ int Game::dropPiece(int coord, int player) {
         return -1;
     }
 
-    // find bottom-most row open in column
-    int bottom = 0;
-    for (int i = 0; i < HEIGHT; i++) {
-        if (board[i][coord] == 0) {
-            bottom = i;
-        }
+    // the lowest open space in the column is the next bit above the pieces
+    int height = __builtin_popcountll(mask & columnMask(coord));
+    uint64_t piece = bottomMask(coord) << height;
+    mask |= piece;
+    if (player == 1) {
+        position |= piece;
     }
+    key ^= ZOBRIST.keys[player == 1 ? 0 : 1][coord * (HEIGHT + 1) + height];
+    mirror_key ^= ZOBRIST.keys[player == 1 ? 0 : 1][(WIDTH - 1 - coord) * (HEIGHT + 1) + height];
 
     // The piece is 'dropped' to the lowest open space in the column coord
+    int bottom = HEIGHT - 1 - height;
     board[bottom][coord] = player;
     // returns the y coordinate of the piece dropped
     return bottom;
 }
 
 
+/**
+ * Drops a piece into the board and checks only the lines through
+ * the new piece for a win
+ * @param coord the x-coordinate to drop from
+ * @param player the id of the player to mark the piece
+ * @param won set true iff the piece completed 4 in a row
+ * @return the y-coord the piece landed at, -1 on fail/full board
+ */
+int Game::dropPiece(int coord, int player, bool & won) {
+    won = false;
+    int bottom = dropPiece(coord, player);
+    if (bottom == -1) {
+        return -1;
+    }
+
+    // walk out from the new piece both ways along each direction, at most
+    // TO_WIN - 1 cells per side (sentinel bits stop runs at column edges)
+    uint64_t own = (player == 1) ? position : (position ^ mask);
+    int at = coord * (HEIGHT + 1) + (HEIGHT - 1 - bottom);
+    const int dirs[4] = {1, HEIGHT + 1, HEIGHT, HEIGHT + 2};
+    for (int d : dirs) {
+        int run = 1;
+        for (int k = at + d; k < 64 && run < TO_WIN && ((own >> k) & 1); k += d) {
+            run++;
+        }
+        for (int k = at - d; k >= 0 && run < TO_WIN && ((own >> k) & 1); k -= d) {
+            run++;
+        }
+        if (run >= TO_WIN) {
+            won = true;
+            break;
+        }
+    }
+    return bottom;
+}
+
+
 /**
  * Identify if the current board is completely full
  * @return true if full, false otherwise
  */
-bool Game::boardIsFull() {
-    for (int i = 0; i < WIDTH; i++) {
-        if (board[0][i] == 0)
-            return false;
-    }
-    return true;
+bool Game::boardIsFull() const {
+    // full iff the top cell of every column is taken
+    uint64_t tops = bottomRow() << (HEIGHT - 1);
+    return (mask & tops) == tops;
 }
 
 
@@ -158,75 +274,60 @@ bool Game::boardIsFull() {
  * @return the id of the winner, 0 on no winner
  */
 int Game::checkForWin() {
-    int current = 0;
-    int streak = 0;
-    // Check for horizontal 4 in a row wins
-    for (int i = 0; i < HEIGHT; i++) {
-        for (int j = 0; j < WIDTH; j++) {
-            if (board[i][j] == current && current) {
-                streak++;
-            } else {
-                current = board[i][j]; streak = 0;
-            }
-            if (streak == TO_WIN - 1) {
-                return current;
-            }
-        }
-        current = 0;
-        streak = 0;
+    if (alignment(position)) {
+        return 1;
+    }
+    if (alignment(position ^ mask)) {
+        return -1;
     }
+    return 0;
+}
 
-    // Check for vertical 4 in a row wins
-    for (int j = 0; j < WIDTH; j++) {
-        for (int i = 0; i < HEIGHT; i++) {
-            if (board[i][j] == current && current) {
-                streak++;
-            } else {
-                current = board[i][j]; streak = 0;
-            }
-            if (streak == TO_WIN - 1) {
-                return current;
-            }
+
+/**
+ * Checks a single player's bitboard for 4 in a row. Each direction is
+ * a fixed bit distance: 1 vertical, HEIGHT+1 horizontal, HEIGHT and
+ * HEIGHT+2 for the two diagonals. The sentinel bit keeps lines from
+ * wrapping between columns.
+ * @param pos the bitboard of one player's pieces
+ * @return true if any line of 4 is present
+ */
+bool Game::alignment(uint64_t pos) {
+    const int dirs[4] = {1, HEIGHT + 1, HEIGHT, HEIGHT + 2};
+    for (int d : dirs) {
+        uint64_t pairs = pos & (pos >> d);
+        if (pairs & (pairs >> (2 * d))) {
+            return true;
         }
-        current = 0;
-        streak = 0;
     }
+    return false;
+}
 
-    for (int i = 0; i < HEIGHT; i++) {
-        for (int j = 0; j < WIDTH; j++) {
-            int cont = 0;
-            int streak = 0;
-            current = 0;
-            //Check for SE diaganol
-            while (i + cont < HEIGHT && j + cont < WIDTH) {
-                if (board[i + cont][j + cont] == current && current) {
-                    streak++;
-                } else {
-                    current = board[i + cont][j + cont]; streak = 0;
-                }
-                if (streak == TO_WIN - 1) {
-                    return current;
-                }
-                cont++;
-            }
-            cont = 0;
-            streak = 0;
-            current = 0;
-            // Check for NW diaganol
-            while (i - cont >= 0 && j - cont >= 0) {
-                if (board[i - cont][j - cont] == current && current) {
-                    streak++;
-                } else {
-                    current = board[i - cont][j - cont]; streak = 0;
-                }
-                if (streak == TO_WIN - 1) {
-                    return current;
-                }
-                cont++;
-            }
 
-        }
+uint64_t Game::bottomMask(int coord) {
+    return 1ULL << (coord * (HEIGHT + 1));
+}
+
+
+uint64_t Game::bottomRow() {
+    uint64_t row = 0;
+    for (int j = 0; j < WIDTH; j++) {
+        row |= bottomMask(j);
     }
+    return row;
+}
 
-    return 0;
+
+uint64_t Game::topMask(int coord) {
+    return (1ULL << (HEIGHT - 1)) << (coord * (HEIGHT + 1));
+}
+
+
+int Game::mirrorBit(int bit) {
+    return (WIDTH - 1 - bit / (HEIGHT + 1)) * (HEIGHT + 1) + bit % (HEIGHT + 1);
+}
+
+
+uint64_t Game::columnMask(int coord) {
+    return ((1ULL << HEIGHT) - 1) << (coord * (HEIGHT + 1));
 }
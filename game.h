@@ -5,6 +5,15 @@
 #include <iomanip>
 #include <vector>
 #include <bitset>
+#include <cstdint>
+
+
+/**
+ * Seed of the Zobrist keys used by Game::getBoard. The keys are the
+ * SplitMix64 stream from this seed, piece of player 1 then of the other
+ * player for each bitboard index. Changing it invalidates saved hashes.
+ */
+static const uint64_t ZOBRIST_SEED = 0x436f6e6e65637434ULL;  // "Connect4"
 
 
 /**
@@ -13,6 +22,10 @@
  * A Game object represents a board that can be played on as well as
  * a set of tools for analyzing the state of the board, and checking
  * validity of making plays on that board.
+ *
+ * The position is held as two bitboards, 7 bits per column (6 rows and
+ * a sentinel bit), bit 0 is the bottom of the left-most column. board
+ * is a mirror of the bitboards kept for printing and the Q learner.
  */
 
 class Game {
@@ -36,6 +49,16 @@ class Game {
          */
         int dropPiece(int coord, int player);
 
+        /**
+         * Drops a piece into the board and checks only the lines through
+         * the new piece for a win
+         * @param coord the x-coordinate to drop from
+         * @param player the id of the player to mark the piece
+         * @param won set true iff the piece completed 4 in a row
+         * @return the y-coord the piece landed at, -1 on fail/full board
+         */
+        int dropPiece(int coord, int player, bool & won);
+
         /**
          * Checks if there is a winner (4 in a row) on the board
          * @return the id of the winner, 0 on no winner
@@ -43,13 +66,37 @@ class Game {
         int checkForWin();
 
         /**
-         * Hashes the current board uniquely for sake of Q learner
-         * @return a unique hash of the board
+         * Hashes the current board uniquely for sake of Q learner, up to
+         * left-right mirroring (a board and its mirror hash the same).
+         * The Zobrist keys are kept up to date by dropPiece/resetGame,
+         * and are stable across runs and builds (see ZOBRIST_SEED)
+         * @return the smaller of the board's and its mirror's keys
          */
         size_t getBoard();
 
         int populateBoardlike(int coord, int player, int (&new_)[6][7]);
 
+        /**
+         * Bitboard of player 1's pieces (layout as in the class doc)
+         * @return the player 1 bitboard
+         */
+        uint64_t getPosition() const;
+
+        /**
+         * Bitboard of every occupied cell (layout as in the class doc)
+         * @return the occupied bitboard
+         */
+        uint64_t getMask() const;
+
+        /**
+         * Set the board to a position given as bitboards, rebuilding the
+         * board view and Zobrist key. Other pieces are marked -1.
+         * @param position bitboard of player 1's pieces
+         * @param mask bitboard of every occupied cell
+         * @return void
+         */
+        void setPosition(uint64_t position, uint64_t mask);
+
 
         /**
          * Checks if a certain drop is valid (not full on coord)
@@ -57,6 +104,26 @@ class Game {
          */
         int validMove(int coord);
 
+        /**
+         * Every valid drop at once
+         * @return bit c set iff column c is not full
+         */
+        uint32_t legalMoves() const;
+
+        /**
+         * Every valid drop of a position given as bitboards
+         * @param mask bitboard of every occupied cell
+         * @return bit c set iff column c is not full
+         */
+        static uint32_t legalMoves(uint64_t mask);
+
+        /**
+         * Checks a single player's bitboard for 4 in a row
+         * @param pos the bitboard of one player's pieces
+         * @return true if any line of 4 is present
+         */
+        static bool alignment(uint64_t pos);
+
         /**
          * Reset the board to it's initial (empty) state
          * @return void
@@ -67,9 +134,9 @@ class Game {
          * Identify if the current board is completely full
          * @return true if full, false otherwise
          */
-         bool boardIsFull();
+         bool boardIsFull() const;
 
-         // The board of this game
+         // The board of this game (row 0 is the top), read only view
          int board[6][7];
 
     private:
@@ -79,5 +146,37 @@ class Game {
         static const int WIDTH = 7;
         //pieces in a row to win
         static const int TO_WIN = 4;
-        // The game board used by this Game
+
+        // Bitboard of the pieces held by player 1
+        uint64_t position;
+        // Bitboard of every occupied cell
+        uint64_t mask;
+        // Zobrist key of the current board / of its mirror, see getBoard
+        uint64_t key;
+        uint64_t mirror_key;
+
+        /**
+         * Bitboard index of a cell's left-right mirror
+         */
+        static int mirrorBit(int bit);
+
+        /**
+         * Bitboard with only the bottom cell of a column set
+         */
+        static uint64_t bottomMask(int coord);
+
+        /**
+         * Bitboard with the bottom cell of every column set
+         */
+        static uint64_t bottomRow();
+
+        /**
+         * Bitboard with only the top playable cell of a column set
+         */
+        static uint64_t topMask(int coord);
+
+        /**
+         * Bitboard with every playable cell of a column set
+         */
+        static uint64_t columnMask(int coord);
 };
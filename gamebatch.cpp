@@ -0,0 +1,161 @@
+#include "gamebatch.h"
+
+/**
+ * GameBatch class
+ *
+ * Many boards stepped at once, see gamebatch.h.
+ */
+
+
+// Top cell of every column (bottom row 0x40810204081 shifted up 5), all
+// set iff the board is full
+static const uint64_t BATCH_TOP_ROW = 0x40810204081ULL << 5;
+
+
+/**
+ * GameBatch Constructor
+ * @param n the number of boards, all empty
+ */
+GameBatch::GameBatch(int n) {
+    this->n = n;
+    this->position.assign(n, 0);
+    this->mask.assign(n, 0);
+}
+
+
+int GameBatch::size() {
+    return this->n;
+}
+
+
+uint64_t GameBatch::getPosition(int i) {
+    return this->position[i];
+}
+
+
+uint64_t GameBatch::getMask(int i) {
+    return this->mask[i];
+}
+
+
+/**
+ * Drop one piece on every board, reporting wins, full boards and invalid
+ * moves per board
+ * @return void
+ */
+void GameBatch::dropPieces(const int * moves, int player, uint8_t * status) {
+    int i = 0;
+#if defined(__AVX2__)
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi64x(1);
+    const __m256i tops = _mm256_set1_epi64x(BATCH_TOP_ROW);
+    for (; i + 4 <= this->n; i += 4) {
+        // column * (HEIGHT + 1) as the shift to its bottom cell, 64 (a
+        // shift to nothing) for columns off the board
+        __m128i col = _mm_loadu_si128((const __m128i *) (moves + i));
+        __m128i on_board = _mm_and_si128(_mm_cmpgt_epi32(col, _mm_set1_epi32(-1)),
+                                         _mm_cmpgt_epi32(_mm_set1_epi32(WIDTH), col));
+        __m128i shift32 = _mm_blendv_epi8(_mm_set1_epi32(64), _mm_mullo_epi32(col, _mm_set1_epi32(HEIGHT + 1)), on_board);
+        __m256i bottom = _mm256_sllv_epi64(one, _mm256_cvtepu32_epi64(shift32));
+        __m256i top = _mm256_slli_epi64(bottom, HEIGHT - 1);
+
+        // legal iff on the board and the column's top cell is free
+        __m256i m = _mm256_loadu_si256((const __m256i *) &this->mask[i]);
+        __m256i pos = _mm256_loadu_si256((const __m256i *) &this->position[i]);
+        __m256i legal = _mm256_andnot_si256(_mm256_cmpeq_epi64(bottom, zero),
+                                            _mm256_cmpeq_epi64(_mm256_and_si256(m, top), zero));
+        bottom = _mm256_and_si256(bottom, legal);
+
+        // adding the bottom cell carries up to the lowest free cell
+        __m256i new_mask = _mm256_or_si256(m, _mm256_add_epi64(m, bottom));
+        if (player == 1) {
+            pos = _mm256_or_si256(pos, _mm256_xor_si256(new_mask, m));
+        }
+        _mm256_storeu_si256((__m256i *) &this->mask[i], new_mask);
+        _mm256_storeu_si256((__m256i *) &this->position[i], pos);
+
+        // 4 in a row for the mover, same shifts as Game::alignment
+        __m256i own = player == 1 ? pos : _mm256_xor_si256(pos, new_mask);
+        __m256i lines = zero;
+        __m256i pairs = _mm256_and_si256(own, _mm256_srli_epi64(own, 1));
+        lines = _mm256_or_si256(lines, _mm256_and_si256(pairs, _mm256_srli_epi64(pairs, 2)));
+        pairs = _mm256_and_si256(own, _mm256_srli_epi64(own, HEIGHT + 1));
+        lines = _mm256_or_si256(lines, _mm256_and_si256(pairs, _mm256_srli_epi64(pairs, 2 * (HEIGHT + 1))));
+        pairs = _mm256_and_si256(own, _mm256_srli_epi64(own, HEIGHT));
+        lines = _mm256_or_si256(lines, _mm256_and_si256(pairs, _mm256_srli_epi64(pairs, 2 * HEIGHT)));
+        pairs = _mm256_and_si256(own, _mm256_srli_epi64(own, HEIGHT + 2));
+        lines = _mm256_or_si256(lines, _mm256_and_si256(pairs, _mm256_srli_epi64(pairs, 2 * (HEIGHT + 2))));
+
+        int won = ~_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(lines, zero)));
+        int full = _mm256_movemask_pd(_mm256_castsi256_pd(
+            _mm256_cmpeq_epi64(_mm256_and_si256(new_mask, tops), tops)));
+        int ok = _mm256_movemask_pd(_mm256_castsi256_pd(legal));
+        for (int k = 0; k < 4; k++) {
+            status[i + k] = (((won & ok) >> k) & 1) * WON | ((full >> k) & 1) * FULL | (((~ok) >> k) & 1) * INVALID;
+        }
+    }
+#endif
+    dropPiecesScalar(i, this->n, moves, player, status);
+}
+
+
+/**
+ * dropPieces for boards [from, to) one at a time
+ * @return void
+ */
+void GameBatch::dropPiecesScalar(int from, int to, const int * moves, int player, uint8_t * status) {
+    const int dirs[4] = {1, HEIGHT + 1, HEIGHT, HEIGHT + 2};
+    for (int i = from; i < to; i++) {
+        int col = moves[i];
+        uint64_t bottom = (col >= 0 && col < WIDTH) ? 1ULL << (col * (HEIGHT + 1)) : 0;
+        uint64_t m = this->mask[i];
+        bool legal = bottom && !(m & (bottom << (HEIGHT - 1)));
+        if (!legal) {
+            status[i] = INVALID | (((m & BATCH_TOP_ROW) == BATCH_TOP_ROW) ? FULL : 0);
+            continue;
+        }
+
+        uint64_t new_mask = m | (m + bottom);
+        if (player == 1) {
+            this->position[i] |= new_mask ^ m;
+        }
+        this->mask[i] = new_mask;
+
+        uint64_t own = player == 1 ? this->position[i] : this->position[i] ^ new_mask;
+        bool won = false;
+        for (int d : dirs) {
+            uint64_t pairs = own & (own >> d);
+            won = won || (pairs & (pairs >> (2 * d)));
+        }
+        status[i] = (won ? WON : 0) | (((new_mask & BATCH_TOP_ROW) == BATCH_TOP_ROW) ? FULL : 0);
+    }
+}
+
+
+/**
+ * Empty the boards flagged
+ * @param reset non-zero for each board to empty
+ * @return void
+ */
+void GameBatch::resetBoards(const uint8_t * reset) {
+    int i = 0;
+#if defined(__AVX2__)
+    const __m256i zero = _mm256_setzero_si256();
+    for (; i + 4 <= this->n; i += 4) {
+        int flags;
+        __builtin_memcpy(&flags, reset + i, sizeof(flags));
+        // all-ones in the boards kept, zero in the boards reset
+        __m256i keep = _mm256_cmpeq_epi64(_mm256_cvtepu8_epi64(_mm_cvtsi32_si128(flags)), zero);
+        __m256i m = _mm256_loadu_si256((const __m256i *) &this->mask[i]);
+        __m256i pos = _mm256_loadu_si256((const __m256i *) &this->position[i]);
+        _mm256_storeu_si256((__m256i *) &this->mask[i], _mm256_and_si256(m, keep));
+        _mm256_storeu_si256((__m256i *) &this->position[i], _mm256_and_si256(pos, keep));
+    }
+#endif
+    for (; i < this->n; i++) {
+        if (reset[i]) {
+            this->position[i] = 0;
+            this->mask[i] = 0;
+        }
+    }
+}
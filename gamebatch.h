@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+
+/**
+ * GameBatch class
+ *
+ * A GameBatch holds many Connect-4 boards as structure-of-arrays
+ * bitboards (same layout as Game) and steps them all at once: one call
+ * drops a piece on every board and reports wins and full boards, another
+ * resets the finished ones. With AVX2 four boards go per instruction,
+ * otherwise the same branch-free kernel runs per board.
+ */
+
+class GameBatch {
+    public:
+        // dropPieces status bits per board
+        static const uint8_t WON = 1;
+        static const uint8_t FULL = 2;
+        static const uint8_t INVALID = 4;
+
+        /**
+         * GameBatch Constructor
+         * @param n the number of boards, all empty
+         */
+        GameBatch(int n);
+
+        /**
+         * @return the number of boards
+         */
+        int size();
+
+        /**
+         * Drop one piece on every board
+         * @param moves the column for each board, -1 (or any invalid
+         * column) leaves that board as is
+         * @param player the id of the player to mark the pieces (1 / -1)
+         * @param status set for each board: WON if the piece completed 4
+         * in a row, FULL if the board is now full, INVALID if no piece
+         * was dropped
+         * @return void
+         */
+        void dropPieces(const int * moves, int player, uint8_t * status);
+
+        /**
+         * Empty the boards flagged
+         * @param reset non-zero for each board to empty
+         * @return void
+         */
+        void resetBoards(const uint8_t * reset);
+
+        /**
+         * Bitboard of player 1's pieces on board i
+         */
+        uint64_t getPosition(int i);
+
+        /**
+         * Bitboard of every occupied cell on board i
+         */
+        uint64_t getMask(int i);
+
+    private:
+        // Const. Height / width of the board
+        static const int HEIGHT = 6;
+        static const int WIDTH = 7;
+        // Number of boards
+        int n;
+        // Player 1's pieces / occupied cells, one per board
+        std::vector<uint64_t> position;
+        std::vector<uint64_t> mask;
+
+        /**
+         * dropPieces for boards [from, to) one at a time
+         */
+        void dropPiecesScalar(int from, int to, const int * moves, int player, uint8_t * status);
+};
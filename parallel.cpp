@@ -0,0 +1,176 @@
+#include "parallel.h"
+#include <chrono>
+#include <thread>
+
+/**
+ * Parallel self-play, see parallel.h.
+ */
+
+
+/**
+ * A worker's game, learners and running counts
+ */
+template <int N>
+struct SelfPlayWorker {
+    Game game;
+    QLearner<N> * red;
+    QLearner<N> * black;
+    int red_wins;
+    int ties;
+    long ct_moves;
+};
+
+
+/**
+ * Trains the given AI with worker threads, merging their tables into
+ * red's every sync_games games per worker
+ * @return non-zero on error
+ */
+template <int N>
+int trainParallel(QLearner<N> * red, QLearner<N> * black, int n_epochs, int n_threads,
+                  int sync_games, bool average, ConcurrentQTable * shared, TrainOptions & opts) {
+    QTable * master = red->getTable();
+    if (shared) {
+        shared->copyFrom(master);
+        if (opts.checkpointer) {
+            std::cout << "\033[1;31mCHECKPOINTS ARE NOT TAKEN WITH A SHARED TABLE\033[0m" << std::endl;
+        }
+    }
+    std::vector<SelfPlayWorker<N> *> workers;
+    for (int t = 0; t < n_threads; t++) {
+        SelfPlayWorker<N> * w = new SelfPlayWorker<N>();
+        w->red = new QLearner<N>(&w->game, red);
+        if (shared) {
+            w->red->setConcurrent(shared);
+        } else {
+            w->red->setShared(master);
+        }
+        w->black = new QLearner<N>(&w->game, black);
+        w->red_wins = 0;
+        w->ties = 0;
+        w->ct_moves = 0;
+        workers.push_back(w);
+    }
+    std::vector<QTable *> deltas;
+    for (SelfPlayWorker<N> * w : workers) {
+        deltas.push_back(w->red->getTable());
+    }
+
+    int epoch = opts.start_epoch;
+    std::chrono::steady_clock::time_point begin_time = std::chrono::steady_clock::now();
+    while (epoch < n_epochs) {
+        // split this round's games evenly over the workers
+        int round = std::min(n_epochs - epoch, sync_games * n_threads);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < n_threads; t++) {
+            int games = round / n_threads + (t < round % n_threads ? 1 : 0);
+            SelfPlayWorker<N> * w = workers[t];
+            threads.push_back(std::thread([w, games]() {
+                for (int g = 0; g < games; g++) {
+                    int winner = playTrainingGame(w->red, w->black, &w->game, w->ct_moves);
+                    if (winner == 1) {
+                        w->red_wins++;
+                    } else if (winner == 0) {
+                        w->ties++;
+                    }
+                }
+                // every update in the table before it is merged
+                w->red->flushUpdates();
+                w->black->flushUpdates();
+            }));
+        }
+        for (std::thread & thread : threads) {
+            thread.join();
+        }
+        epoch += round;
+
+        std::chrono::duration<double> t = std::chrono::steady_clock::now() - begin_time;
+        std::cout << "\r\033[1;36mGAME: " << epoch << "/" << n_epochs << " games/sec: " << (int) (round / t.count());
+        std::cout << "\033[0m" << std::flush;
+        begin_time = std::chrono::steady_clock::now();
+        if (shared) {
+            continue;
+        }
+
+        // fold the workers' changes into the master, then rebase them
+        mergeDeltas(master, deltas, average);
+        for (QTable * delta : deltas) {
+            delta->clear();
+        }
+
+        if (opts.checkpointer) {
+            int red_wins = opts.red_wins;
+            int ties = opts.ties;
+            for (SelfPlayWorker<N> * w : workers) {
+                red_wins += w->red_wins;
+                ties += w->ties;
+            }
+            opts.checkpointer->poll(epoch, red, workers[0]->black, red_wins, ties);
+        }
+    }
+
+    int red_wins = opts.red_wins;
+    int ties = opts.ties;
+    for (SelfPlayWorker<N> * w : workers) {
+        red_wins += w->red_wins;
+        ties += w->ties;
+        delete w->red;
+        delete w->black;
+        delete w;
+    }
+    if (shared) {
+        shared->copyTo(master);
+        std::cout << std::endl << "\033[1;36mSHARED TABLE: \033[0m" << shared->size() << " states, ";
+        std::cout << shared->casRetries() << " CAS retries, " << shared->insertRaces() << " insert races, ";
+        std::cout << shared->insertFailures() << " inserts refused (full)";
+    }
+    std::cout << std::endl<<"\033[1;36mSTOP TRAINING (" << n_threads << " THREADS)\033[0m";
+    std::cout << std::endl<<"\033[1;36m";
+    std::cout << red_wins << ":" << (n_epochs-red_wins) << ":" << ties;
+    std::cout << "\033[0m" << std::endl;
+    return 0;
+}
+
+
+/**
+ * Merges worker tables into a master table
+ * @return the number of states merged
+ */
+size_t mergeDeltas(QTable * master, std::vector<QTable *> & deltas, bool average) {
+    int w = master->width();
+
+    // Sum every worker's change per state first (the last column counts
+    // the workers that updated it, the only ones holding it), so each
+    // worker is measured against the same master.
+    // The sums are float, whatever the master stores.
+    QTable sums(w + 1);
+    for (QTable * delta : deltas) {
+        delta->forEach([&](uint64_t key, void * rewards) {
+            void * base = master->find(key);
+            bool inserted;
+            float * sum = (float *) sums.findOrInsert(key, inserted);
+            for (int i = 0; i < w; i++) {
+                float reward = delta->get(rewards, i);
+                sum[i] += base ? reward - master->get(base, i) : reward;
+            }
+            sum[w] += 1;
+        });
+    }
+
+    sums.forEach([&](uint64_t key, void * sum_values) {
+        float * sum = (float *) sum_values;
+        void * base = master->find(key);
+        if (base) {
+            for (int i = 0; i < w; i++) {
+                master->set(base, i, master->get(base, i) + (average ? sum[i] / sum[w] : sum[i]));
+            }
+        } else {
+            bool inserted;
+            void * rewards = master->findOrInsert(key, inserted);
+            for (int i = 0; i < w; i++) {
+                master->set(rewards, i, sum[i] / sum[w]);
+            }
+        }
+    });
+    return sums.size();
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include "q.h"
+#include "qtable.h"
+#include "concurrent_qtable.h"
+
+
+/**
+ * Parallel self-play
+ *
+ * Each worker thread plays its own Game with its own red/black pair. The
+ * worker red learners read the trained AI's table (the master table)
+ * through QLearner::setShared and hold only the states they updated.
+ * Every sync_games games per worker those deltas are merged into the
+ * master table and the worker tables are cleared, rebasing the workers
+ * onto the merged table. Worker black learners keep their own tables.
+ *
+ * Given a ConcurrentQTable, the worker red learners instead all train
+ * that one table at once (QLearner::setConcurrent), with no deltas to
+ * merge and no per-worker copy of the table.
+ */
+
+/**
+ * Trains the given AI with worker threads, see above.
+ * @param red the trained AI, its table is the master table
+ * @param black the opponent AI, copied for the workers' settings
+ * @param n_epochs total number of games over all workers
+ * @param n_threads number of worker threads
+ * @param sync_games games each worker plays between merges
+ * @param average true to average the updates of a state made by several
+ * workers, false to sum them
+ * @param shared a table all workers train at once, nullptr to merge
+ * per-worker deltas; copied from and back into red's table
+ * @param opts resume point and checkpointing (taken at merges, with
+ * the first worker's opponent, not with a shared table)
+ * @return non-zero on error
+ */
+template <int N>
+int trainParallel(QLearner<N> * red, QLearner<N> * black, int n_epochs, int n_threads,
+                  int sync_games, bool average, ConcurrentQTable * shared, TrainOptions & opts);
+
+/**
+ * Merges worker tables into a master table. A worker's change to a state
+ * is its reward minus the master's. Only workers that updated a state
+ * hold it, so averaging divides by the workers that changed it; states
+ * new to the master take the mean of those workers' rewards.
+ * @param master the table merged into
+ * @param deltas the worker tables, read from master via setShared
+ * @param average true to average the changes to a state, false to sum
+ * @return the number of states merged
+ */
+size_t mergeDeltas(QTable * master, std::vector<QTable *> & deltas, bool average);
@@ -0,0 +1,251 @@
+#include "policy.h"
+
+
+/**
+ * DecisionCache class
+ *
+ * Moves a QPolicy chose by exact position, see policy.h.
+ */
+
+
+/**
+ * DecisionCache Constructor
+ */
+DecisionCache::DecisionCache(size_t entries) {
+    size_t n = 1;
+    while (n < entries) {
+        n <<= 1;
+    }
+    this->entries.reset(new std::atomic<uint64_t>[n]);
+    for (size_t i = 0; i < n; i++) {
+        this->entries[i].store(0, std::memory_order_relaxed);
+    }
+    this->mask = n - 1;
+    this->shift = 64 - __builtin_ctzll(n);
+    // no table version yet, epoch 1 is the first used
+    this->current.store(~(uint64_t) 0 << 12);
+}
+
+
+/**
+ * The column cached for a position
+ * @return the column, -1 if not cached for this version
+ */
+int DecisionCache::find(uint64_t key, uint64_t version) {
+    uint64_t epoch = epochFor(version);
+    uint64_t entry = this->entries[slot(key)].load(std::memory_order_relaxed);
+    if ((entry >> 15) != key || ((entry >> 3) & 0xfff) != epoch) {
+        return -1;
+    }
+    return (int) (entry & 7) - 1;
+}
+
+
+/**
+ * Cache the column chosen for a position
+ * @return void
+ */
+void DecisionCache::store(uint64_t key, uint64_t version, int column) {
+    uint64_t epoch = epochFor(version);
+    uint64_t entry = key << 15 | epoch << 3 | (uint64_t) (column + 1);
+    this->entries[slot(key)].store(entry, std::memory_order_relaxed);
+}
+
+
+/**
+ * Entry of a key, the top bits of a Fibonacci hash (the low bits of the
+ * product only depend on the key's low columns)
+ * @return the entry index
+ */
+size_t DecisionCache::slot(uint64_t key) {
+    return this->shift < 64 ? (key * 0x9e3779b97f4a7c15ULL) >> this->shift : 0;
+}
+
+
+/**
+ * Exact key of a position
+ * @return the key
+ */
+uint64_t DecisionCache::positionKey(uint64_t position, uint64_t mask) {
+    return position + mask;
+}
+
+
+/**
+ * @return the number of entries
+ */
+size_t DecisionCache::size() {
+    return this->mask + 1;
+}
+
+
+/**
+ * The epoch of a table version, starting a new one if the table has
+ * changed. Threads racing to start one agree on whichever wins; an entry
+ * stored under a losing epoch only misses.
+ * @return the epoch
+ */
+uint64_t DecisionCache::epochFor(uint64_t version) {
+    uint64_t current = this->current.load();
+    while ((current >> 12) != (version & (~(uint64_t) 0 >> 12))) {
+        uint64_t epoch = ((current & 0xfff) + 1) & 0xfff;
+        if (epoch == 0) {
+            // wrapped, entries of the last epoch 0 could match again
+            for (size_t i = 0; i <= this->mask; i++) {
+                this->entries[i].store(0, std::memory_order_relaxed);
+            }
+            epoch = 1;
+        }
+        uint64_t next = version << 12 | epoch;
+        if (this->current.compare_exchange_weak(current, next)) {
+            return epoch;
+        }
+    }
+    return current & 0xfff;
+}
+
+
+/**
+ * QPolicy class
+ *
+ * Greedy play of a trained Q table that never changes it, see policy.h.
+ */
+
+
+/**
+ * QPolicy Constructor, no table until loadQ
+ */
+template <int N>
+QPolicy<N>::QPolicy(uint32_t value_type) : keys(nullptr, 0.1, 4, 1, value_type) {
+    this->cache = nullptr;
+    this->table = this->keys.getTable();
+}
+
+
+/**
+ * QPolicy Constructor, plays a learner's table in place
+ */
+template <int N>
+QPolicy<N>::QPolicy(QLearner<N> * learner) : keys(nullptr, learner) {
+    this->cache = nullptr;
+    this->table = learner->getTable();
+}
+
+
+/**
+ * QPolicy Destructor, frees the decision cache
+ */
+template <int N>
+QPolicy<N>::~QPolicy() {
+    delete this->cache;
+}
+
+
+/**
+ * Load a saved table to play
+ * @return 0 on success, -1 if the file can't be opened, -2 if it is not
+ * a table for this filter size / value type / hash scheme
+ */
+template <int N>
+int QPolicy<N>::loadQ(std::string fname) {
+    this->table = this->keys.getTable();
+    return this->keys.loadQ(fname);
+}
+
+
+/**
+ * The greedy move for player 1 on a board
+ * @return the column to drop in, -1 if the board is full
+ */
+template <int N>
+int QPolicy<N>::selectMove(const Game & game) const {
+    return selectMove(game.getPosition(), game.getMask());
+}
+
+
+/**
+ * The greedy move for player 1 on a position given as bitboards, from the
+ * decision cache if it has it
+ * @return the column to drop in, -1 if the board is full
+ */
+template <int N>
+int QPolicy<N>::selectMove(uint64_t position, uint64_t mask, float * reward) const {
+    if (!this->cache || reward) {
+        return searchMove(position, mask, reward);
+    }
+    uint64_t key = DecisionCache::positionKey(position, mask);
+    uint64_t version = this->table->version();
+    int move = this->cache->find(key, version);
+    if (move < 0) {
+        move = searchMove(position, mask, nullptr);
+        if (move >= 0) {
+            this->cache->store(key, version, move);
+        }
+    }
+    return move;
+}
+
+
+/**
+ * The greedy move for player 1 on a position given as bitboards. Every
+ * window's rewards are laid side by side and searched in one sweep, as
+ * QLearner::greedyMove does, on the stack.
+ * @return the column to drop in, -1 if the board is full
+ */
+template <int N>
+int QPolicy<N>::searchMove(uint64_t position, uint64_t mask, float * reward) const {
+    constexpr int total_filters = QLearner<N>::total_filters;
+    uint32_t legal = Game::legalMoves(mask);
+    if (!legal) {
+        return -1;
+    }
+    const uint64_t cols = (1ULL << N) - 1;
+    std::array<float, total_filters * N> candidates;
+    uint64_t candidate_legal = 0;
+    for (int ix = 0; ix < total_filters; ix++) {
+        float * window = candidates.data() + ix * N;
+        bool mirrored;
+        const void * rewards = this->table->peek(this->keys.getSubHash(ix, position, mask, mirrored));
+        if (rewards) {
+            this->table->read(rewards, window);
+        } else {
+            std::fill(window, window + N, 0.0f);
+        }
+        // a mirrored state's actions run right to left across the window
+        if (mirrored) {
+            std::reverse(window, window + N);
+        }
+        candidate_legal |= ((legal >> this->keys.sub_state_locations_x[ix]) & cols) << (ix * N);
+    }
+
+    float best_reward = 0;
+    int best = QLearner<N>::maskedArgmax(candidates.data(), total_filters * N, candidate_legal, best_reward);
+    if (reward) {
+        *reward = best_reward;
+    }
+    if (best < 0) {
+        // no window covers a valid drop, take the first valid column
+        return __builtin_ctz(legal);
+    }
+    return this->keys.sub_state_locations_x[best / N] + best % N;
+}
+
+
+/**
+ * @return the table played
+ */
+template <int N>
+const QTable * QPolicy<N>::getTable() const {
+    return this->table;
+}
+
+
+/**
+ * Cache the moves chosen by position
+ * @return void
+ */
+template <int N>
+void QPolicy<N>::setCache(size_t entries) {
+    delete this->cache;
+    this->cache = entries ? new DecisionCache(entries) : nullptr;
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include "game.h"
+#include "q.h"
+#include "qtable.h"
+
+
+/**
+ * DecisionCache class
+ *
+ * A fixed size, direct-mapped cache of the moves a QPolicy chose, by
+ * exact position. An entry is one atomic word: the position's key (see
+ * positionKey), the cache epoch it was stored in and the column, so
+ * threads share a cache with no locks and a lost race only costs a miss.
+ *
+ * Entries hold for one version of the table (QTable::version): when the
+ * table changes the cache moves to a new epoch and older entries miss.
+ * The epoch has 12 bits, the cache is emptied when it wraps.
+ */
+
+class DecisionCache {
+    public:
+        /**
+         * DecisionCache Constructor
+         * @param entries the number of entries, rounded up to a power of 2
+         */
+        DecisionCache(size_t entries);
+
+        /**
+         * The column cached for a position
+         * @param key the position's key (see positionKey)
+         * @param version the version of the table now
+         * @return the column, -1 if not cached for this version
+         */
+        int find(uint64_t key, uint64_t version);
+
+        /**
+         * Cache the column chosen for a position, replacing whatever held
+         * its entry
+         * @param key the position's key (see positionKey)
+         * @param version the version of the table it was chosen from
+         * @param column the column chosen (0-6)
+         * @return void
+         */
+        void store(uint64_t key, uint64_t version, int column);
+
+        /**
+         * Exact key of a position, position + mask: per column, the
+         * pieces plus a run of ones as tall as the column, unique without
+         * carrying into the next column, 49 bits in all
+         * @param position bitboard of player 1's pieces
+         * @param mask bitboard of every occupied cell
+         * @return the key
+         */
+        static uint64_t positionKey(uint64_t position, uint64_t mask);
+
+        /**
+         * @return the number of entries
+         */
+        size_t size();
+
+    private:
+        // Entries: key << 15 | epoch << 3 | column + 1, 0 when empty
+        std::unique_ptr<std::atomic<uint64_t>[]> entries;
+        // Entries - 1
+        size_t mask;
+        // 64 - log2(entries)
+        int shift;
+        // The table version the epoch is for, version << 12 | epoch
+        std::atomic<uint64_t> current;
+
+        /**
+         * @return the entry of a key
+         */
+        size_t slot(uint64_t key);
+
+        /**
+         * The epoch of a table version, starting a new one if the table
+         * has changed
+         * @return the epoch
+         */
+        uint64_t epochFor(uint64_t version);
+};
+
+
+/**
+ * QPolicy class
+ *
+ * A QPolicy plays a trained Q table greedily without ever changing it:
+ * selectMove is const, allocates nothing and writes nothing but its stack
+ * (and the decision cache, if set), so any number of threads may share
+ * one policy (and its one table).
+ * Windows missing from the table count as reward 0 rather than being
+ * added with a random reward as QLearner does, so a policy's moves depend
+ * only on the table and the board.
+ *
+ * The table is either a learner's (read in place, the learner must not
+ * train during a selectMove, the cache notices training between calls)
+ * or a saved table loaded with loadQ.
+ */
+
+template <int N>
+class QPolicy {
+    public:
+        /**
+         * QPolicy Constructor, no table until loadQ
+         * @param value_type how the table to load stores rewards
+         */
+        QPolicy(uint32_t value_type = QTable::VALUE_FLOAT32);
+
+        /**
+         * QPolicy Constructor, plays a learner's table in place
+         * @param learner the trained learner
+         */
+        QPolicy(QLearner<N> * learner);
+
+        /**
+         * QPolicy Destructor, frees the decision cache
+         */
+        ~QPolicy();
+
+        QPolicy(const QPolicy &) = delete;
+        QPolicy & operator=(const QPolicy &) = delete;
+
+        /**
+         * Load a saved table (memory-mapped, see QLearner::loadQ) to play
+         * @return 0 on success, -1 if the file can't be opened, -2 if it
+         * is not a table for this filter size / value type / hash scheme
+         */
+        int loadQ(std::string fname);
+
+        /**
+         * The greedy move for player 1 (the player the table was trained
+         * as) on a board
+         * @param game the board
+         * @return the column to drop in, -1 if the board is full
+         */
+        int selectMove(const Game & game) const;
+
+        /**
+         * The greedy move for player 1 on a position given as bitboards
+         * (see Game::getPosition / Game::getMask); swap the colors
+         * (position ^ mask) to move for player -1
+         * @param position bitboard of player 1's pieces
+         * @param mask bitboard of every occupied cell
+         * @param reward set to the move's reward, may be nullptr
+         * @return the column to drop in, -1 if the board is full
+         */
+        int selectMove(uint64_t position, uint64_t mask, float * reward = nullptr) const;
+
+        /**
+         * @return the table played
+         */
+        const QTable * getTable() const;
+
+        /**
+         * Cache the moves chosen by position (see DecisionCache), which
+         * pays when the same positions come up again and again (openings,
+         * a server's clients); selectMove asking for the reward skips it
+         * @param entries the cache size, 0 for no cache
+         * @return void
+         */
+        void setCache(size_t entries);
+
+    private:
+        // Moves chosen by position, nullptr for none
+        DecisionCache * cache;
+
+        // The window layout and keys, and the table of a loaded policy
+        QLearner<N> keys;
+        // The table played (keys' or a learner's)
+        const QTable * table;
+
+        /**
+         * selectMove without the cache
+         * @return the column to drop in, -1 if the board is full
+         */
+        int searchMove(uint64_t position, uint64_t mask, float * reward) const;
+};
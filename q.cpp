@@ -13,16 +13,51 @@
 /**
  * QLearner Constructor
  */
-QLearner::QLearner(Game * game, double a, int e, int id, int fsize) {
+template <int N>
+QLearner<N>::QLearner(Game * game, double a, int e, int id, uint32_t value_type) : own_table(N, value_type) {
     this->game = game;
+    this->table = &this->own_table;
+    this->shared = nullptr;
+    this->concurrent = nullptr;
+    this->telemetry = nullptr;
+    this->updates = &this->pending;
+    this->update_batch = 0;
     this->alpha = a;
     this->epsilon = e;
     this->action = 0;
     this->state = 0;
+    this->hash_loc = 0;
+    this->relative_action = 0;
     this->id = id;
-    this->filter_size = fsize;
-    this->sub_state_locations_x = new int[HEIGHT*WIDTH];
-    this->sub_state_locations_y = new int[HEIGHT*WIDTH];
+    // seeded from rand() so srand still picks the run's randomness
+    this->rand_state = (((uint64_t) rand() << 32) ^ (uint64_t) rand()) | 1;
+    // The filter locations are fixed by the size, lay them out once
+    int conv_ct = 0;
+    for (int i = 0; i <= this->HEIGHT - N; i++) {
+        for (int j = 0; j <= this->WIDTH - N; j++) {
+            this->sub_state_locations_x[conv_ct] = j;
+            this->sub_state_locations_y[conv_ct] = i;
+
+            // rows i..i+fsize-1 from the top are these heights from the bottom
+            int low = HEIGHT - i - N;
+            uint64_t col = ((1ULL << N) - 1) << low;
+            this->window_masks[conv_ct] = 0;
+            for (int jx = 0; jx < N; jx++) {
+                this->window_masks[conv_ct] |= col << ((j + jx) * (HEIGHT + 1));
+            }
+            conv_ct++;
+        }
+    }
+}
+
+/**
+ * QLearner Constructor, same settings (and table value type) as another
+ * learner with an empty table
+ */
+template <int N>
+QLearner<N>::QLearner(Game * game, QLearner * like)
+    : QLearner(game, like->alpha, like->epsilon, like->id, like->table->valueType()) {
+    setUpdateBatch(like->update_batch);
 }
 
 /**
@@ -33,80 +68,82 @@ QLearner::QLearner(Game * game, double a, int e, int id, int fsize) {
  * @param train true for training / false for gameplay or validation
  * @return the coord to drop at (pass to Game obj.)
  */
-int QLearner::makeMove(bool train) {
-    if (rand()%this->epsilon != 0 || !train) {
+template <int N>
+int QLearner<N>::makeMove(bool train) {
+    if (nextRand()%this->epsilon != 0 || !train) {
         return this->greedyMove();
     } else {
-        this->action = rand() % WIDTH;
+        this->action = nextRand() % WIDTH;
         return this->action;
     }
 }
 
 
 /**
- * Make a greedy move based on the current Q table (private)
+ * Make a greedy move based on the current Q table (private). Every
+ * window's rewards are searched in one sweep, skipping drops into full
+ * columns
  * @return the coordinate to drop a piece with maximum reward
  */
-int QLearner::greedyMove() {
-    this->max_reward = 0.0;
-    convGreedyDecider();
+template <int N>
+int QLearner<N>::greedyMove() {
     size_t* hashes = convGreedyDecider();
-
-    float max_so_far = -100.0;
-    int to_drop = 0;
-
-    // track the position
-    int left_pos = 0;
-
-    for (int ix = 0; ix < this->total_filters; ix++) {
-        left_pos = this->sub_state_locations_x[ix];
-        int act = bestFromState(hashes[ix], max_so_far, left_pos);
-        if (game->validMove(left_pos + act)) {
-            continue;
+    uint32_t legal = this->game->legalMoves();
+    const uint64_t cols = (1ULL << N) - 1;
+
+    // lay the windows' rewards side by side, with the valid drops of each
+    uint64_t candidate_legal = 0;
+    for (int ix = 0; ix < total_filters; ix++) {
+        float * window = this->candidates.data() + ix * N;
+        if (this->concurrent) {
+            float * probs = concurrentRewards(hashes[ix]);
+            std::copy(probs, probs + N, window);
+        } else {
+            readRewards(hashes[ix], window);
         }
-        if (this->max_reward > max_so_far) {
-            to_drop = act + left_pos;
-            this->relative_action = act;
-            this->state = hashes[ix];
-            this->hash_loc = ix;
-            max_so_far = this->max_reward;
+        // a mirrored state's actions run right to left across the window
+        if (this->mirrored[ix]) {
+            std::reverse(window, window + N);
         }
+        candidate_legal |= ((legal >> this->sub_state_locations_x[ix]) & cols) << (ix * N);
     }
 
-    this->action = to_drop;
-    return to_drop;
+    int best = maskedArgmax(this->candidates.data(), total_filters * N, candidate_legal, this->max_reward);
+    if (best < 0) {
+        // no window covers a valid drop, take the first valid column
+        if (this->telemetry) {
+            this->telemetry->counters.fallbacks++;
+        }
+        this->action = legal ? __builtin_ctz(legal) : 0;
+        return this->action;
+    }
+    this->hash_loc = best / N;
+    this->state = hashes[this->hash_loc];
+    // the action is kept in the state's orientation, for update
+    int column = best % N;
+    this->relative_action = this->mirrored[this->hash_loc] ? N - 1 - column : column;
+    this->action = this->sub_state_locations_x[this->hash_loc] + column;
+    return this->action;
 }
 
 
 /**
  * Update the Q table for this player based on the current state.
+ * Call after the move has been dropped into the game.
  * @param winner the winner of this round, 0 if no winner
- * @param player the player who made the new move
  * @param move the coordinate the piece was dropped at
- * @param hash a hash of the current state
  * @return the reward function value of the new state
  */
-int QLearner::update(int winner, int player, int move, size_t hash) {
+template <int N>
+int QLearner<N>::update(int winner, int move) {
     if (move == -1) {
         return -1;
     }
     // the current state
     size_t state = this->state;
 
-    // the future state
-    int a[6][7];
-    game->populateBoardlike(move, player, a);
-    size_t fut_state = getSubHash(sub_state_locations_x[hash_loc], sub_state_locations_y[hash_loc], a);
-
-    // Get rewards of these states -> init if empty
-    if (!table.count(fut_state)) {
-        this->table[fut_state]= new std::vector<float>(this->filter_size, (rand() % 100) * 0.01);
-    }
-    if (!table.count(state)) {
-        this->table[state]= new std::vector<float>(this->filter_size, (rand() % 100) * 0.01);
-    }
-
-    float old_reward = table[state]->at(this->relative_action);
+    // the future state, the move has already been dropped into the game
+    size_t fut_state = getSubHash(hash_loc, game->getPosition(), game->getMask());
 
     // Choose a reward for the new move
     int r = 0;
@@ -117,30 +154,168 @@ int QLearner::update(int winner, int player, int move, size_t hash) {
     } else {
         r = 1;
     }
-    // Find max reward in the future
-    std::vector<float> * probs = table[fut_state];
-    float exp_future_reward = -100000;
-    for (int i = 0; i < this->filter_size; i++) {
-        if (probs->at(i) > exp_future_reward) {
-            exp_future_reward = probs->at(i);
+    QUpdate u = {state, this->relative_action, r, fut_state, false, 0};
+
+    // shared tables take the change as an atomic add (same as old + change)
+    if (this->concurrent) {
+        float exp_future_reward = 0;
+        maskedArgmax(concurrentRewards(fut_state), N, ~0ULL, exp_future_reward);
+        std::atomic<float> * rewards = this->concurrent->findOrInsert(state, (nextRand() % 100) * 0.01);
+        if (rewards) {
+            this->concurrent->add(rewards + this->relative_action, 0.5 * (r + 0.7 * exp_future_reward));
+        }
+        return r;
+    }
+    if (this->update_batch) {
+        this->updates->push_back(u);
+        if ((int) this->updates->size() >= this->update_batch) {
+            flushUpdates();
         }
+        return r;
     }
-    float new_ = old_reward + 0.5 * (r + 0.7 *  exp_future_reward);
-    table[state]->at(this->relative_action) = new_;
+
+    // Find max reward in the future (read first, the next lookup may insert)
+    u.future = futureReward(fut_state);
+    applyUpdate(u);
     this->state = state;
 
     return r;
 }
 
 
+/**
+ * Read the best reward of a state
+ * @param hash the state key
+ * @return the state's highest reward
+ */
+template <int N>
+float QLearner<N>::futureReward(size_t hash) {
+    float * probs = this->scratch_rewards.data();
+    readRewards(hash, probs);
+    float best = 0;
+    maskedArgmax(probs, N, ~0ULL, best);
+    return best;
+}
+
+
+/**
+ * Apply an update, its future reward read. A 16-bit table saturates at
+ * its range.
+ * @return void
+ */
+template <int N>
+void QLearner<N>::applyUpdate(const QUpdate & u) {
+    void * rewards = rewardsFor(u.state);
+    if (u.terminal) {
+        this->table->set(rewards, u.action, u.reward);
+        return;
+    }
+    float old_reward = this->table->get(rewards, u.action);
+    float new_ = old_reward + 0.5 * (u.reward + 0.7 * u.future);
+    this->table->set(rewards, u.action, new_);
+}
+
+
+/**
+ * Buffer updates and apply them batch_size at a time (see header)
+ * @param batch_size updates per batch, 0 to apply each at once
+ * @return void
+ */
+template <int N>
+void QLearner<N>::setUpdateBatch(int batch_size) {
+    flushUpdates();
+    this->update_batch = std::max(0, batch_size);
+    // sized once, so buffering never allocates in the move path
+    this->updates->reserve(this->update_batch);
+    this->update_order.reserve(this->update_batch);
+}
+
+
+/**
+ * Apply every buffered update: the future rewards of the batch first,
+ * then the updates, each pass in table order
+ * @return the number of updates applied
+ */
+template <int N>
+int QLearner<N>::flushUpdates() {
+    std::vector<QUpdate> & batch = *this->updates;
+    int n = (int) batch.size();
+    if (n == 0) {
+        return 0;
+    }
+    // ahead of the lookup, far enough for a miss to land in time
+    const int prefetch_ahead = 8;
+
+    int n_future = orderUpdates(true);
+    for (int k = 0; k < n_future; k++) {
+        if (k + prefetch_ahead < n_future) {
+            this->table->prefetch(batch[this->update_order[k + prefetch_ahead]].next_state);
+        }
+        QUpdate & u = batch[this->update_order[k]];
+        u.future = futureReward(u.next_state);
+    }
+
+    orderUpdates(false);
+    for (int k = 0; k < n; k++) {
+        if (k + prefetch_ahead < n) {
+            this->table->prefetch(batch[this->update_order[k + prefetch_ahead]].state);
+        }
+        applyUpdate(batch[this->update_order[k]]);
+    }
+    batch.clear();
+    return n;
+}
+
+
+/**
+ * Put the buffered updates in table order by state or next_state, into
+ * update_order: a counting sort into ORDER_BUCKETS regions of the table,
+ * two linear passes where a comparison sort costs more than the cache
+ * misses it saves. Stable, so updates to a state keep the order they
+ * were made in. Terminal updates have no next_state and are left out of
+ * that order.
+ * @return the number of updates ordered
+ */
+template <int N>
+int QLearner<N>::orderUpdates(bool by_next_state) {
+    std::vector<QUpdate> & batch = *this->updates;
+    const int shift = 64 - __builtin_ctz(ORDER_BUCKETS);
+    std::array<int, ORDER_BUCKETS> starts{};
+    int n = 0;
+    for (const QUpdate & u : batch) {
+        if (by_next_state && u.terminal) {
+            continue;
+        }
+        starts[this->table->order(by_next_state ? u.next_state : u.state) >> shift]++;
+        n++;
+    }
+    int at = 0;
+    for (int & start : starts) {
+        int ct = start;
+        start = at;
+        at += ct;
+    }
+    this->update_order.resize(n);
+    for (int k = 0; k < (int) batch.size(); k++) {
+        const QUpdate & u = batch[k];
+        if (by_next_state && u.terminal) {
+            continue;
+        }
+        this->update_order[starts[this->table->order(by_next_state ? u.next_state : u.state) >> shift]++] = k;
+    }
+    return n;
+}
+
+
 /**
  * Print the rewards vector for the current state to std out
  * @return void
  */
-void QLearner::showRews() {
-    std::map<size_t, std::vector<float>*>::iterator it = table.find(this->state);
-    for (int i = 0; i < this->filter_size; i++) {
-        std::cout << it->second->at(i) << " ";
+template <int N>
+void QLearner<N>::showRews() {
+    void * rewards = this->table->find(this->state);
+    for (int i = 0; rewards && i < N; i++) {
+        std::cout << this->table->get(rewards, i) << " ";
     }
     std::cout << std::endl << this->relative_action << std::endl;
     return;
@@ -148,165 +323,215 @@ void QLearner::showRews() {
 
 
 /**
- * Save the current Q table for this AI to CSV-like file
- * (comma seperated values in newline seperated states)
+ * Save the current Q table for this AI to a binary table file
+ * (see QTableHeader)
  * @return 0 on success, non-zero on file error/fail to write
  */
-int QLearner::saveQ(std::string fname) {
-    std::ofstream stream(fname, std::ofstream::trunc);
-    std::cout << "\033[1;32mSAVING... MAY TAKE A MINUTE\033[0m" << std::endl;
-
-    int ct_saves = 0;
-    for(auto& kv : this->table) {
-        stream << (kv.first) << ",";
-        for(int i = 0; i < this->filter_size; i++) {
-            stream << kv.second->at(i)<< ",";
-        }
-        stream << "\n";
-        ct_saves++;
+template <int N>
+int QLearner<N>::saveQ(std::string fname) {
+    std::cout << "\033[1;32mSAVING...\033[0m" << std::endl;
+    flushUpdates();
+
+    long ct_saves = this->table->save(fname, HASH_SCHEME, nullptr);
+    if (ct_saves < 0) {
+        std::cout << "\033[1;31mFAILED TO SAVE " << fname << "\033[0m" << std::endl;
+        return -1;
     }
     std::cout <<"\033[1;32mSAVED: \033[0m"<< ct_saves << " states and reward vectors to";
     std::cout << "\033[1;32m " <<fname <<"\033[0m" << std::endl;
-    stream.close();
     return 0;
 }
 
 
 /**
  * Load a Q table from file, and apply to this AI. Formatted as saveQ
- * formats (comma seperated values in newline seperated states)
- * @return a Q table
- */
-int QLearner::loadQ(std::string fname) {
-    std::cout << "\033[1;32mLOADING... MAY TAKE A MINUTE\033[0m" << std::endl;
-    std::fstream newfile;
-    newfile.open(fname, std::ios::in);
-
-    int ct_rows = 0;
-    if(newfile.is_open()) {
-        std::string line;
-
-        // For each line
-        while(std::getline(newfile, line)) {
-            // identify the hash
-            char * line_c = &line[0];
-            size_t hash = (size_t) atoi(strtok(line_c, ","));
-            // populate the vector with rewards as read
-            if (this->table.count(hash) != 0) {
-                continue;
-            } else {
-                this->table[hash]= new std::vector<float>(this->filter_size, 0);
-            }
-
-            for (int i = 0; i < this->filter_size; i++) {
-                float value = (float) atoi(strtok(line_c, ","));
-                this->table[hash]->at(i) = value;
-            }
-            ct_rows++;
-
-        }
-        newfile.close();
-
-        std::cout <<"\033[1;32mLOADED: \033[0m"<< ct_rows << " states and reward vectors from";
-        std::cout << "\033[1;32m " <<fname <<"\033[0m" << std::endl;
-        return 0;
-    } else {
-        return -1;
+ * formats, the file is memory-mapped rather than parsed
+ * @return 0 on success, -1 if the file can't be opened, -2 if it is not a
+ * table for this filter size / hash scheme
+ */
+template <int N>
+int QLearner<N>::loadQ(std::string fname) {
+    long ct_rows = this->table->load(fname, HASH_SCHEME, nullptr);
+    if (ct_rows < 0) {
+        return (int) ct_rows;
     }
+    std::cout <<"\033[1;32mLOADED: \033[0m"<< ct_rows << " states and reward vectors from";
+    std::cout << "\033[1;32m " <<fname <<"\033[0m" << std::endl;
+    return 0;
 }
 
 
 /**
  * Creates hashes of the filter applied to each possible location
- * on the board.
- * @return an array of hashes in L->R T->D order
+ * on the board, into this learner's hashes buffer.
+ * @return the hashes buffer in L->R T->D order
  */
-size_t* QLearner::convGreedyDecider() {
-    int size = this->filter_size;
+template <int N>
+size_t* QLearner<N>::convGreedyDecider() {
+    size_t* hashes = this->hashes.data();
+
+    // Every window is read from the same two bitboards
+    uint64_t position = this->game->getPosition();
+    uint64_t mask = this->game->getMask();
+    for (int ix = 0; ix < total_filters; ix++) {
+        hashes[ix] = getSubHash(ix, position, mask, this->mirrored[ix]);
+    }
+    return hashes;
+}
 
-    size_t* hashes = new size_t[HEIGHT*WIDTH];
 
-    int conv_ct = 0;
-    std::string hold_conv = "";
+/**
+ * Gather the cells of window loc from a bitboard into the low bits,
+ * column by column from the bottom cell up (PEXT on BMI2)
+ * @return the window's bits
+ */
+template <int N>
+uint64_t QLearner<N>::windowBits(uint64_t plane, int loc) const {
+#if defined(__BMI2__)
+    return _pext_u64(plane, this->window_masks[loc]);
+#else
+    int low = HEIGHT - this->sub_state_locations_y[loc] - N;
+    int left = this->sub_state_locations_x[loc];
+    const uint64_t col = (1ULL << N) - 1;
+    uint64_t bits = 0;
+    for (int jx = 0; jx < N; jx++) {
+        bits |= ((plane >> ((left + jx) * (HEIGHT + 1) + low)) & col) << (jx * N);
+    }
+    return bits;
+#endif
+}
 
-    // For each location, great a filter
-    for (int i = 0; i < this->HEIGHT - size; i++) {
-        for (int j = 0; j < this->WIDTH - size; j++) {
 
+/**
+ * Make a key for the filter at window loc of a board, the smaller of
+ * the window's and its mirror's (see header)
+ * @param mirrored set true iff the key is the mirror's
+ * @return the key, 0 for a window with a full top row
+ */
+template <int N>
+size_t QLearner<N>::getSubHash(int loc, uint64_t position, uint64_t mask, bool & mirrored) const {
+    uint64_t occupied = windowBits(mask, loc);
+    uint64_t red = windowBits(position, loc);
+    size_t key = packWindow(occupied, red);
+    size_t mirror_key = packWindow(mirrorWindow(occupied), mirrorWindow(red));
+    mirrored = mirror_key < key;
+    return mirrored ? mirror_key : key;
+}
 
-            // Note the location of this hash for immediate movement
-            this->sub_state_locations_x[conv_ct] = j;
-            this->sub_state_locations_y[conv_ct] = i;
 
-            // Save this hash
-            hashes[conv_ct] = getSubHash(i, j, this->game->board);
+/**
+ * getSubHash without the orientation
+ * @return the key
+ */
+template <int N>
+size_t QLearner<N>::getSubHash(int loc, uint64_t position, uint64_t mask) const {
+    bool mirrored;
+    return getSubHash(loc, position, mask, mirrored);
+}
 
 
-            hold_conv = "";
-            conv_ct++;
+/**
+ * Pack a window's cells into an exact key (see header)
+ * @return the key, 0 for a window with a full top row
+ */
+template <int N>
+size_t QLearner<N>::packWindow(uint64_t occupied, uint64_t red) {
+    const int cells = N * N;
+
+    // handle boards with a full top row (top cell of every window column)
+    constexpr uint64_t top = [] {
+        uint64_t cells_top = 0;
+        for (int jx = 0; jx < N; jx++) {
+            cells_top |= 1ULL << (jx * N + N - 1);
         }
+        return cells_top;
+    }();
+    if ((occupied & top) == top) {
+        return 0;
     }
-    this->total_filters = conv_ct;
-    return hashes;
-}
 
-size_t QLearner::getSubHash(int i, int j, int board[6][7]) {
-    std::hash<std::string> hash;
-    int top_row_full = 0;
-    int size = this->filter_size;
-    std::string hold_conv = "";
-    // For each filter, for a string that represents piece positions
-    for (int ix = 0; ix < size && i + ix < HEIGHT; ix++) {
-        for (int jx = 0; jx < size && j + jx < WIDTH; jx++) {
-            // handle boards with a full top row / track fullness
-            if (ix == 0 && board[i+ix][j+jx] != 0) {
-                top_row_full++;
-            }
-            hold_conv += std::to_string((board[i+ix][j+jx]));
+    const uint64_t marker = 1ULL << 63;
+    if constexpr (2 * cells < 64) {
+        return marker | (occupied << cells) | red;
+    } else {
+        // too wide for two bit-planes, one base 3 digit per cell instead
+        uint64_t key = 0;
+        for (int k = cells - 1; k >= 0; k--) {
+            uint64_t digit = ((occupied >> k) & 1) ? (((red >> k) & 1) ? 1 : 2) : 0;
+            key = key * 3 + digit;
         }
+        return marker | key;
     }
-    if (top_row_full == this->filter_size) {
-        return 0;
-    }
-    return hash(hold_conv);
 }
+
+
 /**
- * Find the best move for the current sub-state
- * @return the best (most rewarded) move
+ * Reverse the column order of a window's cells
+ * @return the left-right mirror of the window
  */
-int QLearner::bestFromState(size_t hash, float target, int left_pos) {
-
-    // init for stability on not found (end of itt)
-    if (!table.count(hash)) {
-        this->table[hash]= new std::vector<float>(this->filter_size, (rand() % 100) * 0.01);
+template <int N>
+uint64_t QLearner<N>::mirrorWindow(uint64_t bits) {
+    const uint64_t col = (1ULL << N) - 1;
+    uint64_t mirror = 0;
+    for (int jx = 0; jx < N; jx++) {
+        mirror |= ((bits >> (jx * N)) & col) << ((N - 1 - jx) * N);
     }
+    return mirror;
+}
 
-    // make a move in a greedy manner
-    std::vector<float> * probs = table[hash];
-    auto best = std::max_element(probs->begin(), probs->end());
-    int max = std::distance(probs->begin(), best);
 
-    // Invalid moves from this state are punished down to an extreme low
-    // The next most rewarded value is used until a maximal valid move is found
-    float best_rew = 0;
-    int ct_stuck = 0;
-    while (this->game->validMove(max + left_pos) != 0) {
-        best_rew = 0;
-        probs->at(max) = 0;
-        for (int i = 0; i < this->filter_size; i++) {
-            if (i != max && probs->at(i) > best_rew) {
-                max = i;
-                best_rew = probs->at(i);
-            }
-        if (ct_stuck > this->filter_size) {
-            return rand() % this->filter_size;
+/**
+ * Find the highest legal value in one pass, the first one on ties
+ * @param values the values to search, never modified
+ * @param n the number of values, at most 64
+ * @param legal bit i set iff values[i] may be picked
+ * @param best set to the value found
+ * @return the index of the value, -1 if none is legal
+ */
+template <int N>
+int QLearner<N>::maskedArgmax(const float * values, int n, uint64_t legal, float & best) {
+    const float lowest = -std::numeric_limits<float>::infinity();
+    float top = lowest;
+    int top_ix = -1;
+    int i = 0;
+#if defined(__SSE2__)
+    // per lane best value / index, illegal values read as -inf
+    const __m128i lane_bits = _mm_setr_epi32(1, 2, 4, 8);
+    const __m128 low = _mm_set1_ps(lowest);
+    __m128 tops = low;
+    __m128i top_ixs = _mm_set1_epi32(-1);
+    __m128i ixs = _mm_setr_epi32(0, 1, 2, 3);
+    for (; i + 4 <= n; i += 4) {
+        __m128i bits = _mm_and_si128(_mm_set1_epi32((int) ((legal >> i) & 15)), lane_bits);
+        __m128 ok = _mm_castsi128_ps(_mm_cmpeq_epi32(bits, lane_bits));
+        __m128 v = _mm_or_ps(_mm_and_ps(ok, _mm_loadu_ps(values + i)), _mm_andnot_ps(ok, low));
+        // strictly greater keeps the first index of each lane's best
+        __m128i better = _mm_castps_si128(_mm_cmpgt_ps(v, tops));
+        tops = _mm_max_ps(tops, v);
+        top_ixs = _mm_or_si128(_mm_and_si128(better, ixs), _mm_andnot_si128(better, top_ixs));
+        ixs = _mm_add_epi32(ixs, _mm_set1_epi32(4));
+    }
+    alignas(16) float lane_tops[4];
+    alignas(16) int lane_ixs[4];
+    _mm_store_ps(lane_tops, tops);
+    _mm_store_si128((__m128i *) lane_ixs, top_ixs);
+    for (int k = 0; k < 4; k++) {
+        if (lane_ixs[k] >= 0 && (top_ix < 0 || lane_tops[k] > top ||
+                                 (lane_tops[k] == top && lane_ixs[k] < top_ix))) {
+            top = lane_tops[k];
+            top_ix = lane_ixs[k];
         }
-        ct_stuck++;
+    }
+#endif
+    // the rest (all of it without SSE2) come after every index above
+    for (; i < n; i++) {
+        if (((legal >> i) & 1) && (top_ix < 0 || values[i] > top)) {
+            top = values[i];
+            top_ix = i;
         }
     }
-
-    this->max_reward = probs->at(max);
-    return max;
+    best = top;
+    return top_ix;
 }
 
 
@@ -314,11 +539,201 @@ int QLearner::bestFromState(size_t hash, float target, int left_pos) {
  * Update a loss on this player
  * @return void
  */
-void QLearner::updateLoss() {
+template <int N>
+void QLearner<N>::updateLoss() {
     // Update the current state/action pair with a loss
-    if (!table.count(this->state)) {
-        table[this->state]= new std::vector<float>(this->filter_size, (rand() % 100) * 0.01);
+    if (this->concurrent) {
+        std::atomic<float> * rewards = this->concurrent->findOrInsert(this->state, (nextRand() % 100) * 0.01);
+        if (rewards) {
+            rewards[this->relative_action].store(-800, std::memory_order_relaxed);
+        }
+        return;
     }
-    table[this->state]->at(this->relative_action) = -800;
+    QUpdate u = {this->state, this->relative_action, -800, 0, true, 0};
+    if (this->update_batch) {
+        this->updates->push_back(u);
+        if ((int) this->updates->size() >= this->update_batch) {
+            flushUpdates();
+        }
+        return;
+    }
+    applyUpdate(u);
     return;
 }
+
+
+/**
+ * @return the Q table of this learner
+ */
+template <int N>
+QTable * QLearner<N>::getTable() {
+    return this->table;
+}
+
+
+/**
+ * Find the rewards for a state, adding it with a random initial reward
+ * (or the shared table's rewards) if it has not been seen
+ * @param hash the state key
+ * @return the state's N stored rewards (valid until next insert)
+ */
+template <int N>
+void * QLearner<N>::rewardsFor(size_t hash) {
+    bool inserted = false;
+    void * rewards = this->table->findOrInsert(hash, inserted);
+    if (this->telemetry) {
+        TelemetryCounters & c = this->telemetry->counters;
+        c.lookups++;
+        c.hits += !inserted;
+        c.misses += inserted;
+        c.inserts += inserted;
+    }
+    if (inserted) {
+        const void * base = this->shared ? this->shared->peek(hash) : nullptr;
+        if (base) {
+            this->shared->read(base, this->scratch_rewards.data());
+        } else {
+            this->scratch_rewards.fill((nextRand() % 100) * 0.01);
+        }
+        this->table->write(rewards, this->scratch_rewards.data());
+    }
+    return rewards;
+}
+
+
+/**
+ * Copy a state's rewards out. Reading through to a shared table adds
+ * nothing to this learner's table, only updates do.
+ * @param hash the state key
+ * @param out set to the state's N rewards
+ * @return void
+ */
+template <int N>
+void QLearner<N>::readRewards(size_t hash, float * out) {
+    if (!this->shared) {
+        this->table->read(rewardsFor(hash), out);
+        return;
+    }
+    const void * rewards = this->table->find(hash);
+    if (this->telemetry) {
+        TelemetryCounters & c = this->telemetry->counters;
+        c.lookups++;
+        c.hits += rewards != nullptr;
+        c.misses += rewards == nullptr;
+    }
+    if (rewards) {
+        this->table->read(rewards, out);
+        return;
+    }
+    const void * base = this->shared->peek(hash);
+    if (base) {
+        this->shared->read(base, out);
+    } else {
+        std::fill(out, out + N, (nextRand() % 100) * 0.01);
+    }
+}
+
+
+/**
+ * Copy a state's rewards from the concurrent table into scratch_rewards,
+ * adding the state if it has not been seen (a full table leaves the
+ * random initial rewards in scratch only)
+ * @param hash the state key
+ * @return scratch_rewards
+ */
+template <int N>
+float * QLearner<N>::concurrentRewards(size_t hash) {
+    float init = (nextRand() % 100) * 0.01;
+    std::atomic<float> * rewards = this->concurrent->findOrInsert(hash, init);
+    for (int i = 0; i < N; i++) {
+        this->scratch_rewards[i] = rewards ? rewards[i].load(std::memory_order_relaxed) : init;
+    }
+    return this->scratch_rewards.data();
+}
+
+
+/**
+ * Train another learner's table in place of this learner's own
+ * @param owner the learner whose table to use
+ * @return void
+ */
+template <int N>
+void QLearner<N>::useTableOf(QLearner * owner) {
+    flushUpdates();
+    this->table = owner->table;
+    this->updates = owner->updates;
+    this->update_batch = owner->update_batch;
+}
+
+
+/**
+ * Count this learner's table lookups and greedy fallbacks
+ * @param telemetry the counters to add to, nullptr for none
+ * @return void
+ */
+template <int N>
+void QLearner<N>::setTelemetry(Telemetry * telemetry) {
+    this->telemetry = telemetry;
+}
+
+
+/**
+ * Use a table shared with other threads in place of this learner's own
+ * @param concurrent the shared table, nullptr to use our own
+ * @return void
+ */
+template <int N>
+void QLearner<N>::setConcurrent(ConcurrentQTable * concurrent) {
+    this->concurrent = concurrent;
+}
+
+
+/**
+ * Read states missing from this learner's table from a shared table
+ * @param shared the table to read through to, nullptr for none
+ * @return void
+ */
+template <int N>
+void QLearner<N>::setShared(QTable * shared) {
+    this->shared = shared;
+}
+
+
+/**
+ * Next number from this learner's generator (xorshift64*)
+ * @return a non-negative random int
+ */
+template <int N>
+int QLearner<N>::nextRand() {
+    this->rand_state ^= this->rand_state >> 12;
+    this->rand_state ^= this->rand_state << 25;
+    this->rand_state ^= this->rand_state >> 27;
+    return (int) ((this->rand_state * 0x2545f4914f6cdd1dULL) >> 33);
+}
+
+
+/**
+ * Copy out the random generator and the last state / action taken
+ * @param s set to RUN_STATE_WORDS words, for setRunState
+ * @return void
+ */
+template <int N>
+void QLearner<N>::getRunState(uint64_t * s) {
+    s[0] = this->rand_state;
+    s[1] = this->state;
+    s[2] = ((uint64_t) (uint32_t) this->relative_action << 32) | (uint32_t) this->hash_loc;
+}
+
+
+/**
+ * Restore what getRunState copied out
+ * @param s RUN_STATE_WORDS words from getRunState
+ * @return void
+ */
+template <int N>
+void QLearner<N>::setRunState(const uint64_t * s) {
+    this->rand_state = s[0] ? s[0] : 1;
+    this->state = s[1];
+    this->relative_action = (int) (s[2] >> 32);
+    this->hash_loc = (int) (uint32_t) s[2];
+}
@@ -9,6 +9,18 @@
 #include "game.h"
 #include <time.h>
 #include "fstream"
+#include "qtable.h"
+#include "concurrent_qtable.h"
+#include "telemetry.h"
+#include <cstdint>
+#include <array>
+#include <limits>
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 
 /**
@@ -17,14 +29,58 @@
  * A QLearner object represents a policy reinforcement Q learner that
  * makes moves based on the dominant outcome reward for any given Game
  * objects Game::getBoard.
+ *
+ * The filter size N is a template parameter so the window layout, key
+ * and reward loops are all fixed at compile time (sizes 3-6 are built,
+ * see main).
  */
 
+template <int N>
+struct QLearnerBench;
+
+template <int N>
+class QPolicy;
+
+
+/**
+ * A Q update waiting to be applied (see QLearner::setUpdateBatch)
+ */
+struct QUpdate {
+    // The state / action updated
+    uint64_t state;
+    int action;
+    // The move's reward
+    int reward;
+    // The state the move led to, read for its best reward
+    uint64_t next_state;
+    // true to set the reward outright (a loss), next_state unused
+    bool terminal;
+    // The best reward of next_state, read when the batch is applied
+    float future;
+};
+
+
+template <int N>
 class QLearner {
     public:
+        // Key scheme of getSubHash, saved with and checked against tables
+        // (2: a window and its mirror share a key, 3: the windows on the
+        // bottom row and the rightmost column are keyed too)
+        static const uint32_t HASH_SCHEME = 3;
+
         /**
          * QLearner Constructor
+         * @param value_type how the Q table stores rewards (QTable::VALUE_*)
+         */
+        QLearner(Game * game, double a, int e, int id, uint32_t value_type = QTable::VALUE_FLOAT32);
+
+        /**
+         * QLearner Constructor, same settings (and table value type) as
+         * another learner with an empty table
+         * @param game the game this learner plays in
+         * @param like the learner to copy settings from
          */
-        QLearner(Game * game, double a, int e, int id, int fsize);
+        QLearner(Game * game, QLearner * like);
 
         /**
          * Have this AI make a move based on the current state, training
@@ -38,25 +94,26 @@ class QLearner {
 
         /**
          * Update the Q table for this player based on the current state.
+         * Call after the move has been dropped into the game. A 16-bit
+         * table saturates rather than overflow.
          * @param winner the winner of this round, 0 if no winner
-         * @param player the player who made the new move
          * @param move the coordinate the piece was dropped at
-         * @param hash a hash of the current state
          * @return the reward function value of the new state
          */
-        int update(int winner, int player, int move, size_t hash);
+        int update(int winner, int move);
 
         /**
-         * Save the current Q table for this AI to CSV-like file.
-         * (comma seperated values in newline seperated states)
+         * Save the current Q table for this AI to a binary table file
+         * (see QTableHeader)
          * @return 0 on success, non-zero on file error/fail to write
          */
         int saveQ(std::string fname);
 
         /**
          * Load a Q table from file, and apply to this AI. Formatted as saveQ
-         * formats (comma seperated values in newline seperated states)
-         * @return a Q table
+         * formats, the file is memory-mapped rather than parsed
+         * @return 0 on success, -1 if the file can't be opened, -2 if it
+         * is not a table for this filter size / hash scheme
          */
         int loadQ(std::string fname);
 
@@ -72,9 +129,169 @@ class QLearner {
          */
         void updateLoss();
 
+        /**
+         * Buffer updates (update / updateLoss) and apply them batch_size
+         * at a time instead of as they are made. A batch reads the best
+         * future reward of every update first, then applies them all,
+         * each pass sorted into table order with the next lookups
+         * prefetched, so a table far larger than cache is swept rather
+         * than hit at random. Moves chosen meanwhile see rewards up to a
+         * batch old. Not used with a concurrent table.
+         * @param batch_size updates per batch, 0 to apply each at once
+         * @return void
+         */
+        void setUpdateBatch(int batch_size);
+
+        /**
+         * Apply every buffered update, call before reading or saving the
+         * table (saveQ does)
+         * @return the number of updates applied
+         */
+        int flushUpdates();
+
+        /**
+         * @return the Q table of this learner
+         */
+        QTable * getTable();
+
+        /**
+         * Read states missing from this learner's table from a shared
+         * table instead of initializing them randomly. This learner's
+         * table then holds only the states it updates (a delta over the
+         * shared table, reads don't add to it), the shared table is
+         * never written.
+         * @param shared the table to read through to, nullptr for none
+         * @return void
+         */
+        void setShared(QTable * shared);
+
+        /**
+         * Train another learner's table in place of this learner's own,
+         * for several learners in one thread (e.g. one per board of a
+         * GameBatch) to learn together. Updates are buffered with the
+         * owner's (see setUpdateBatch).
+         * @param owner the learner whose table to use
+         * @return void
+         */
+        void useTableOf(QLearner * owner);
+
+        /**
+         * Use a table shared with other threads in place of this
+         * learner's own table. Rewards are read into scratch and updates
+         * are atomic adds, so many learners can train it at once.
+         * @param concurrent the shared table, nullptr to use our own
+         * @return void
+         */
+        void setConcurrent(ConcurrentQTable * concurrent);
+
+        /**
+         * Count this learner's table lookups and greedy fallbacks
+         * @param telemetry the counters to add to, nullptr for none
+         * @return void
+         */
+        void setTelemetry(Telemetry * telemetry);
+
+        /**
+         * Copy out what this learner carries between moves and games:
+         * the random generator and the last state / action taken
+         * @param s set to RUN_STATE_WORDS words, for setRunState
+         * @return void
+         */
+        void getRunState(uint64_t * s);
+
+        /**
+         * Restore what getRunState copied out, to resume training exactly
+         * @param s RUN_STATE_WORDS words from getRunState
+         * @return void
+         */
+        void setRunState(const uint64_t * s);
+
+        // Words of state copied by getRunState
+        static const int RUN_STATE_WORDS = 3;
+
     private:
+        // bench.cpp times the private steps of a move directly
+        friend struct QLearnerBench<N>;
+        // QPolicy plays with the window keys of a learner
+        friend class QPolicy<N>;
+
         // The Q table for this QLearner
-        std::map<size_t, std::vector<float>*> table;
+        QTable * table;
+        // The table this QLearner owns (table unless useTableOf is used)
+        QTable own_table;
+        // Read-only table behind this one (see setShared), may be nullptr
+        QTable * shared;
+        // Table used in place of ours (see setConcurrent), may be nullptr
+        ConcurrentQTable * concurrent;
+        // Training counters (see setTelemetry), nullptr when off
+        Telemetry * telemetry;
+        // Buffered updates (see setUpdateBatch), pending unless
+        // useTableOf is used
+        std::vector<QUpdate> * updates;
+        std::vector<QUpdate> pending;
+        // Updates per batch, 0 to apply each at once
+        int update_batch;
+        // Buffered update indices in table order, for flushUpdates
+        std::vector<int> update_order;
+        // Table regions flushUpdates orders updates by (a power of 2)
+        static const int ORDER_BUCKETS = 1 << 11;
+
+        /**
+         * Read the best reward of a state
+         * @param hash the state key
+         * @return the state's highest reward
+         */
+        float futureReward(size_t hash);
+
+        /**
+         * Apply an update, its future reward read
+         * @return void
+         */
+        void applyUpdate(const QUpdate & u);
+
+        /**
+         * Put the buffered updates in table order by state or
+         * next_state, into update_order
+         * @return the number of updates ordered
+         */
+        int orderUpdates(bool by_next_state);
+
+        /**
+         * Copy a state's rewards from the concurrent table into
+         * scratch_rewards, adding the state if it has not been seen
+         * @param hash the state key
+         * @return scratch_rewards
+         */
+        float * concurrentRewards(size_t hash);
+
+        /**
+         * Find the rewards for a state, adding it with a random initial
+         * reward (or the shared table's rewards) if it has not been seen
+         * @param hash the state key
+         * @return the state's N stored rewards, read and written through
+         * the table (valid until next insert)
+         */
+        void * rewardsFor(size_t hash);
+
+        /**
+         * Copy a state's rewards out, as rewardsFor would find them. With
+         * a shared table the state is not added to this learner's table
+         * (a state in neither table reads as fresh random rewards)
+         * @param hash the state key
+         * @param out set to the state's N rewards
+         * @return void
+         */
+        void readRewards(size_t hash, float * out);
+
+        /**
+         * Next number from this learner's generator (xorshift64*), used
+         * in place of rand() so training can be resumed exactly
+         * @return a non-negative random int
+         */
+        int nextRand();
+
+        // State of the random generator, never 0
+        uint64_t rand_state;
 
         /**
          * Make a greedy move based on the current Q table
@@ -84,22 +301,65 @@ class QLearner {
 
         /**
          * Creates hashes of the filter applied to each possible location
-         * on the board.
-         * @return an array of hashes in L->R T->D order
+         * on the board, into this learner's hashes buffer.
+         * @return the hashes buffer in L->R T->D order
          */
         size_t* convGreedyDecider();
 
         /**
-         * Find the best move for the current sub-state
-         * @return the best (most rewarded) move
+         * Find the highest legal value in one pass (4 at a time on SSE2),
+         * the first one on ties. values is never modified.
+         * @param values the values to search
+         * @param n the number of values, at most 64
+         * @param legal bit i set iff values[i] may be picked
+         * @param best set to the value found
+         * @return the index of the value, -1 if none is legal
+         */
+        static int maskedArgmax(const float * values, int n, uint64_t legal, float & best);
+
+        /**
+         * Make a key for the filter at window loc of a board. The key is
+         * canonical: the smaller of the keys of the window and its
+         * left-right mirror (see packWindow), so both share one state
+         * whose rewards are in the orientation of the smaller key
+         * @param loc the window index (see sub_state_locations_x/y)
+         * @param position bitboard of player 1's pieces
+         * @param mask bitboard of occupied cells
+         * @param mirrored set true iff the key is the mirror's, the
+         * state's action a is then column N - 1 - a of the window
+         * return the key
+         */
+        size_t getSubHash(int loc, uint64_t position, uint64_t mask, bool & mirrored) const;
+
+        /**
+         * getSubHash without the orientation
+         * return the key
+         */
+        size_t getSubHash(int loc, uint64_t position, uint64_t mask) const;
+
+        /**
+         * Pack a window's cells into a key. The key is exact: the
+         * occupied and player 1 bit-planes side by side (base 3 digits
+         * when those need over 63 bits) under a marker bit, 0 is
+         * reserved for windows with a full top row
+         * @param occupied the window's occupied cells (see windowBits)
+         * @param red the window's player 1 cells
+         * return the key
+         */
+        static size_t packWindow(uint64_t occupied, uint64_t red);
+
+        /**
+         * Reverse the column order of a window's cells (see windowBits)
+         * @return the left-right mirror of the window
          */
-        int bestFromState(size_t state, float target, int left_pos);
+        static uint64_t mirrorWindow(uint64_t bits);
 
         /**
-         * Make a hash for a board at the given position
-         * return the hash
+         * Gather the cells of window loc from a bitboard into the low
+         * bits, column by column from the bottom cell up (PEXT on BMI2)
+         * @return the window's bits
          */
-        size_t getSubHash(int i, int j, int board[6][7]);
+        uint64_t windowBits(uint64_t plane, int loc) const;
 
         // The game that this QLearner is playing in
         Game * game;
@@ -117,24 +377,34 @@ class QLearner {
         double alpha;
         // define epsilon greedy action with random action chance 1/epsilon
         int epsilon;
-        // total filters on the convulation
-        int total_filters;
         // a file to save Q Table to
         std::ofstream save_movement;
         // The board height
-        const int HEIGHT = 6;
+        static const int HEIGHT = 6;
         // The board width
-        const int WIDTH = 7;
+        static const int WIDTH = 7;
         // The maximum reward in the current state
         float max_reward;
-        // The size of the filters used
-        int filter_size;
-        // The relative action taken in the current sub-state
+        // total filters on the convulation, every N x N window of the
+        // board (at most 64 / N, see maskedArgmax)
+        static constexpr int total_filters = (HEIGHT - N + 1) * (WIDTH - N + 1);
+        // The relative action taken in the current sub-state (in the
+        // state's orientation, see getSubHash)
         int relative_action;
 
         // the locations of each current sub-state
-        int* sub_state_locations_x;
-        int* sub_state_locations_y;
+        std::array<int, total_filters> sub_state_locations_x;
+        std::array<int, total_filters> sub_state_locations_y;
+        // the bitboard cells covered by each sub-state
+        std::array<uint64_t, total_filters> window_masks;
+        // scratch for the current hash of each sub-state, and whether it
+        // is the key of the window's mirror
+        std::array<size_t, total_filters> hashes;
+        std::array<bool, total_filters> mirrored;
+        // Copy of one state's rewards, as floats
+        std::array<float, N> scratch_rewards;
+        // Rewards of every window side by side, for greedyMove
+        std::array<float, total_filters * N> candidates;
 
 
 };
@@ -0,0 +1,691 @@
+#include "qtable.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+/**
+ * QTable class
+ *
+ * A QTable maps 64-bit state keys to a fixed number of rewards, see
+ * qtable.h.
+ */
+
+
+// States per slot before the table is grown
+static const double MAX_LOAD = 0.7;
+// States sampled per eviction
+static const int EVICT_SAMPLES = 8;
+// Largest rewards a 16-bit table holds, writes saturate here
+static const float INT16_MAX_REWARD = 32767 / QTable::INT16_SCALE;
+static const float INT16_MIN_REWARD = -32768 / QTable::INT16_SCALE;
+static const float FLOAT16_MAX_REWARD = 65504;
+
+
+/**
+ * QTable Constructor
+ * @param width the number of rewards stored per state
+ * @param value_type how each reward is stored, VALUE_*
+ */
+QTable::QTable(int width, uint32_t value_type) {
+    this->w = width;
+    this->vtype = value_type;
+    this->stride = width * (value_type == VALUE_FLOAT32 ? sizeof(float) : sizeof(uint16_t));
+    this->count = 0;
+    this->ct_growths = 0;
+    this->ct_version = 0;
+    this->bits = 10;
+    this->keys.assign(1ULL << this->bits, EMPTY_KEY);
+    this->values.assign((1ULL << this->bits) * this->stride, 0);
+    this->visits.assign(1ULL << this->bits, 0);
+    this->carry.assign(this->stride, 0);
+    this->max_bytes = 0;
+    this->ct_evictions = 0;
+    this->evict_rand = 0x9e3779b97f4a7c15ULL;
+    this->map_addr = nullptr;
+    this->map_len = 0;
+    this->base_keys = nullptr;
+    this->base_values = nullptr;
+    this->base_count = 0;
+}
+
+
+/**
+ * QTable Destructor, unmaps any loaded file
+ */
+QTable::~QTable() {
+    unmap();
+}
+
+
+/**
+ * Home slot of a key, fibonacci hashing so the structured low bits of
+ * window keys spread over the whole table
+ */
+size_t QTable::home(uint64_t key) const {
+    return (size_t) (order(key) >> (64 - this->bits));
+}
+
+
+/**
+ * Find the rewards for a state, counting a visit
+ * @param key the state key
+ * @return the state's stored rewards, nullptr if not present
+ */
+void * QTable::find(uint64_t key) {
+    this->ct_version++;
+    size_t slot;
+    const uint8_t * rewards = lookup(key, slot);
+    // saturating, eviction ages it back down
+    if (slot != NO_SLOT) {
+        this->visits[slot] += this->visits[slot] < 255;
+    }
+    // the table is ours to change
+    return (void *) rewards;
+}
+
+
+/**
+ * Find the rewards for a state without counting a visit
+ * @param key the state key
+ * @return the state's stored rewards, nullptr if not present
+ */
+const void * QTable::peek(uint64_t key) const {
+    size_t slot;
+    return lookup(key, slot);
+}
+
+
+/**
+ * Find the rewards for a state
+ * @param slot set to the state's hash table slot, NO_SLOT if it is in the
+ * loaded file or not present
+ * @return the state's stored rewards, nullptr if not present
+ */
+const uint8_t * QTable::lookup(uint64_t key, size_t & slot) const {
+    slot = NO_SLOT;
+    // loaded states are found by binary search of the mapped keys
+    if (this->base_count) {
+        const uint64_t * end = this->base_keys + this->base_count;
+        const uint64_t * at = std::lower_bound(this->base_keys, end, key);
+        if (at != end && *at == key) {
+            return this->base_values + (at - this->base_keys) * this->stride;
+        }
+    }
+
+    size_t mask = this->keys.size() - 1;
+    size_t at = home(key);
+    // Robin Hood order: stop once the resident is closer to home than we are
+    for (size_t dist = 0; ; dist++, at = (at + 1) & mask) {
+        uint64_t resident = this->keys[at];
+        if (resident == key) {
+            slot = at;
+            return &this->values[at * this->stride];
+        }
+        if (resident == EMPTY_KEY || ((at - home(resident)) & mask) < dist) {
+            return nullptr;
+        }
+    }
+}
+
+
+/**
+ * Find the rewards for a state, inserting it if absent. New rewards are
+ * zeroed for the caller to initialize.
+ * @param key the state key
+ * @param inserted set true iff the state was just inserted
+ * @return the state's stored rewards
+ */
+void * QTable::findOrInsert(uint64_t key, bool & inserted) {
+    void * found = find(key);
+    if (found) {
+        inserted = false;
+        return found;
+    }
+    inserted = true;
+    if (this->count + 1 > MAX_LOAD * this->keys.size()) {
+        // grow while the budget allows, then make room instead
+        if (!this->max_bytes || 2 * this->keys.size() * slotBytes() <= this->max_bytes) {
+            grow();
+        } else {
+            evictOne();
+        }
+    }
+
+    size_t mask = this->keys.size() - 1;
+    size_t slot = home(key);
+    size_t dist = 0;
+    size_t placed = SIZE_MAX;
+    // the new state's rewards start zeroed, counted as one visit
+    std::fill(this->carry.begin(), this->carry.end(), 0);
+    uint8_t carry_visits = 1;
+
+    // Walk the probe run, taking slots from residents closer to home
+    while (true) {
+        uint64_t resident = this->keys[slot];
+        uint8_t * slot_vals = &this->values[slot * this->stride];
+        if (resident == EMPTY_KEY) {
+            this->keys[slot] = key;
+            this->visits[slot] = carry_visits;
+            std::copy(this->carry.begin(), this->carry.end(), slot_vals);
+            if (placed == SIZE_MAX) {
+                placed = slot;
+            }
+            break;
+        }
+        size_t resident_dist = (slot - home(resident)) & mask;
+        if (resident_dist < dist) {
+            // the travelling entry takes this slot, the resident moves on
+            std::swap_ranges(this->carry.begin(), this->carry.end(), slot_vals);
+            std::swap(carry_visits, this->visits[slot]);
+            this->keys[slot] = key;
+            key = resident;
+            dist = resident_dist;
+            if (placed == SIZE_MAX) {
+                placed = slot;
+            }
+        }
+        slot = (slot + 1) & mask;
+        dist++;
+    }
+    this->count++;
+    return &this->values[placed * this->stride];
+}
+
+
+/**
+ * Evict one state, LFU by sampling: of EVICT_SAMPLES random states the
+ * least visited goes and the rest have their visits halved, so a state
+ * has to keep being visited to stay. Sampling all over the table (not
+ * sweeping or sampling one spot) keeps the free slots spread evenly, so
+ * the probe runs stay as short as they are before the budget is hit.
+ * @return void
+ */
+void QTable::evictOne() {
+    size_t mask = this->keys.size() - 1;
+    size_t sampled[EVICT_SAMPLES];
+    int victim = 0;
+    for (int k = 0; k < EVICT_SAMPLES; k++) {
+        // xorshift64, retried past free slots
+        size_t slot;
+        do {
+            this->evict_rand ^= this->evict_rand << 13;
+            this->evict_rand ^= this->evict_rand >> 7;
+            this->evict_rand ^= this->evict_rand << 17;
+            slot = (this->evict_rand >> 20) & mask;
+        } while (this->keys[slot] == EMPTY_KEY);
+        sampled[k] = slot;
+        if (this->visits[slot] < this->visits[sampled[victim]]) {
+            victim = k;
+        }
+    }
+    for (int k = 0; k < EVICT_SAMPLES; k++) {
+        this->visits[sampled[k]] >>= 1;
+    }
+    // a state sampled twice is still only erased once
+    erase(sampled[victim]);
+    this->ct_evictions++;
+}
+
+
+/**
+ * Empty a slot by backward shift: the entries after it move back one
+ * slot until one is at home, so no tombstones are left for probes
+ * @return void
+ */
+void QTable::erase(size_t slot) {
+    size_t mask = this->keys.size() - 1;
+    size_t next = (slot + 1) & mask;
+    while (this->keys[next] != EMPTY_KEY && ((next - home(this->keys[next])) & mask) != 0) {
+        this->keys[slot] = this->keys[next];
+        this->visits[slot] = this->visits[next];
+        memcpy(&this->values[slot * this->stride], &this->values[next * this->stride], this->stride);
+        slot = next;
+        next = (next + 1) & mask;
+    }
+    this->keys[slot] = EMPTY_KEY;
+    this->count--;
+}
+
+
+/**
+ * Start loading the slot a state hashes to into cache (its probe run
+ * starts there, and its rewards sit at the same slot)
+ * @return void
+ */
+void QTable::prefetch(uint64_t key) {
+    size_t slot = home(key);
+    __builtin_prefetch(&this->keys[slot]);
+    __builtin_prefetch(&this->values[slot * this->stride]);
+}
+
+
+/**
+ * Sort key placing states in table order, the hash home slots are the
+ * top bits of
+ * @return the sort key
+ */
+uint64_t QTable::order(uint64_t key) const {
+    return key * 0x9e3779b97f4a7c15ULL;
+}
+
+
+/**
+ * Read one stored reward
+ * @return the reward
+ */
+float QTable::get(const void * rewards, int i) const {
+    if (this->vtype == VALUE_INT16) {
+        return ((const int16_t *) rewards)[i] * (1 / INT16_SCALE);
+    } else if (this->vtype == VALUE_FLOAT16) {
+        return fromHalf(((const uint16_t *) rewards)[i]);
+    }
+    return ((const float *) rewards)[i];
+}
+
+
+/**
+ * Write one stored reward, clamped to a 16-bit table's range so repeated
+ * updates saturate instead of wrapping around
+ * @return void
+ */
+void QTable::set(void * rewards, int i, float reward) {
+    if (this->vtype == VALUE_INT16) {
+        reward = std::min(std::max(reward, INT16_MIN_REWARD), INT16_MAX_REWARD);
+        ((int16_t *) rewards)[i] = (int16_t) std::lrint(reward * INT16_SCALE);
+    } else if (this->vtype == VALUE_FLOAT16) {
+        reward = std::min(std::max(reward, -FLOAT16_MAX_REWARD), FLOAT16_MAX_REWARD);
+        ((uint16_t *) rewards)[i] = toHalf(reward);
+    } else {
+        ((float *) rewards)[i] = reward;
+    }
+}
+
+
+/**
+ * Read all of a state's rewards
+ * @return void
+ */
+void QTable::read(const void * rewards, float * out) const {
+    if (this->vtype == VALUE_FLOAT32) {
+        memcpy(out, rewards, this->stride);
+        return;
+    }
+    for (int i = 0; i < this->w; i++) {
+        out[i] = get(rewards, i);
+    }
+}
+
+
+/**
+ * Write all of a state's rewards
+ * @return void
+ */
+void QTable::write(void * rewards, const float * in) {
+    for (int i = 0; i < this->w; i++) {
+        set(rewards, i, in[i]);
+    }
+}
+
+
+/**
+ * Encode a half precision float, rounding to nearest even. Callers clamp
+ * to the half range first, so no infinities are made.
+ * @return the half's bits
+ */
+uint16_t QTable::toHalf(float value) {
+#if defined(__F16C__)
+    return _cvtss_sh(value, _MM_FROUND_TO_NEAREST_INT);
+#else
+    uint32_t x;
+    memcpy(&x, &value, sizeof(x));
+    uint16_t sign = (x >> 16) & 0x8000;
+    x &= 0x7fffffff;
+    // below the smallest normal half (2^-14), a multiple of 2^-24
+    if (x < 0x38800000) {
+        float magnitude;
+        memcpy(&magnitude, &x, sizeof(magnitude));
+        return sign | (uint16_t) std::lrint(magnitude * 16777216.0f);
+    }
+    // rebias the exponent (127 to 15), keep 10 of the 23 mantissa bits
+    uint32_t half = (x - 0x38000000) >> 13;
+    uint32_t rest = x & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+        half++;
+    }
+    return sign | (uint16_t) half;
+#endif
+}
+
+
+/**
+ * Decode a half precision float
+ * @return the value
+ */
+float QTable::fromHalf(uint16_t half) {
+#if defined(__F16C__)
+    return _cvtsh_ss(half);
+#else
+    uint32_t sign = (uint32_t) (half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1f;
+    uint32_t mantissa = half & 0x3ff;
+    if (exponent == 0) {
+        float magnitude = mantissa * (1 / 16777216.0f);
+        return sign ? -magnitude : magnitude;
+    }
+    uint32_t x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    float value;
+    memcpy(&value, &x, sizeof(value));
+    return value;
+#endif
+}
+
+
+/**
+ * Double the slot count and reinsert every state
+ * @return void
+ */
+void QTable::grow() {
+    std::vector<uint64_t> old_keys;
+    std::vector<uint8_t> old_values;
+    std::vector<uint8_t> old_visits;
+    old_keys.swap(this->keys);
+    old_values.swap(this->values);
+    old_visits.swap(this->visits);
+
+    this->bits++;
+    this->ct_growths++;
+    this->keys.assign(1ULL << this->bits, EMPTY_KEY);
+    this->values.assign((1ULL << this->bits) * this->stride, 0);
+    this->visits.assign(1ULL << this->bits, 0);
+    this->count = 0;
+
+    for (size_t i = 0; i < old_keys.size(); i++) {
+        if (old_keys[i] != EMPTY_KEY) {
+            bool inserted;
+            uint8_t * dest = (uint8_t *) findOrInsert(old_keys[i], inserted);
+            memcpy(dest, &old_values[i * this->stride], this->stride);
+            this->visits[(dest - this->values.data()) / this->stride] = old_visits[i];
+        }
+    }
+}
+
+
+/**
+ * Write every state to a file, sorted by key, through fname.tmp and a
+ * rename
+ * @param fname the file to write
+ * @param hash_scheme the key scheme of the caller, checked on load
+ * @param meta saved in the header for the caller, may be nullptr
+ * @return the number of states written, -1 on file error
+ */
+long QTable::save(std::string fname, uint32_t hash_scheme, const uint64_t * meta) {
+    // the hash table in key order, merged with the (sorted) loaded keys
+    std::vector<std::pair<uint64_t, const uint8_t *>> added;
+    added.reserve(this->count);
+    for (size_t slot = 0; slot < this->keys.size(); slot++) {
+        if (this->keys[slot] != EMPTY_KEY) {
+            added.push_back(std::make_pair(this->keys[slot], &this->values[slot * this->stride]));
+        }
+    }
+    std::sort(added.begin(), added.end());
+
+    QTableHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, QTABLE_MAGIC, sizeof(header.magic));
+    header.version = QTABLE_VERSION;
+    header.width = this->w;
+    header.value_type = this->vtype;
+    header.hash_scheme = hash_scheme;
+    header.count = this->base_count + added.size();
+    header.keys_offset = (sizeof(header) + 63) & ~63ULL;
+    header.values_offset = (header.keys_offset + header.count * sizeof(uint64_t) + 63) & ~63ULL;
+    if (meta) {
+        memcpy(header.meta, meta, sizeof(header.meta));
+    }
+
+    std::string tmp = fname + ".tmp";
+    std::ofstream stream(tmp, std::ofstream::binary | std::ofstream::trunc);
+    if (!stream.is_open()) {
+        return -1;
+    }
+    const char zeros[64] = {0};
+    stream.write((const char *) &header, sizeof(header));
+    stream.write(zeros, header.keys_offset - sizeof(header));
+
+    // two merge passes over the same order, keys then rewards
+    for (int pass = 0; pass < 2; pass++) {
+        size_t b = 0;
+        size_t a = 0;
+        while (b < this->base_count || a < added.size()) {
+            bool from_base = a == added.size() ||
+                (b < this->base_count && this->base_keys[b] < added[a].first);
+            uint64_t key = from_base ? this->base_keys[b] : added[a].first;
+            const uint8_t * rewards = from_base ? this->base_values + b * this->stride : added[a].second;
+            if (pass == 0) {
+                stream.write((const char *) &key, sizeof(key));
+            } else {
+                stream.write((const char *) rewards, this->stride);
+            }
+            if (from_base) {
+                b++;
+            } else {
+                a++;
+            }
+        }
+        if (pass == 0) {
+            stream.write(zeros, header.values_offset - header.keys_offset - header.count * sizeof(uint64_t));
+        }
+    }
+    stream.close();
+    if (!stream || rename(tmp.c_str(), fname.c_str()) != 0) {
+        return -1;
+    }
+    return (long) header.count;
+}
+
+
+/**
+ * Replace this table with one saved by save, the file is mapped (copy
+ * on write) rather than parsed
+ * @param fname the file to read
+ * @param hash_scheme the key scheme of the caller
+ * @param meta set to the header's caller data, may be nullptr
+ * @return the number of states, -1 if the file can't be opened, -2 if it
+ * is not a compatible table
+ */
+long QTable::load(std::string fname, uint32_t hash_scheme, uint64_t * meta) {
+    int fd = open(fname.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(QTableHeader)) {
+        close(fd);
+        std::cout << "\033[1;31m" << fname << " is not a Q table\033[0m" << std::endl;
+        return -2;
+    }
+    size_t len = st.st_size;
+    void * addr = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return -1;
+    }
+
+    // Reject anything this learner would misread
+    const QTableHeader * header = (const QTableHeader *) addr;
+    const char * problem = nullptr;
+    bool size_mismatch = false;
+    bool type_mismatch = false;
+    if (memcmp(header->magic, QTABLE_MAGIC, sizeof(header->magic)) != 0) {
+        problem = "is not a Q table";
+    } else if (header->version != QTABLE_VERSION) {
+        problem = "has an unsupported version";
+    } else if ((int) header->width != this->w) {
+        problem = "was trained with a different filter size";
+        size_mismatch = true;
+    } else if (header->value_type != this->vtype) {
+        problem = "stores its rewards as a different value type";
+        type_mismatch = header->value_type <= VALUE_FLOAT16;
+    } else if (header->hash_scheme != hash_scheme) {
+        problem = "was saved with a different hash scheme";
+    } else if (header->keys_offset < sizeof(QTableHeader) || header->keys_offset > len ||
+               header->keys_offset % alignof(uint64_t) != 0 ||
+               header->values_offset < sizeof(QTableHeader) || header->values_offset > len) {
+        problem = "has a corrupt header";
+    } else if (header->count > (len - header->keys_offset) / sizeof(uint64_t) ||
+               header->count > (len - header->values_offset) / this->stride) {
+        // divided rather than multiplied, a huge count can't wrap around
+        problem = "is truncated";
+    }
+    if (problem) {
+        std::cout << "\033[1;31m" << fname << " " << problem;
+        if (size_mismatch) {
+            std::cout << " (" << header->width << ", not " << this->w << ")";
+        }
+        if (type_mismatch) {
+            std::cout << " (" << valueTypeName(header->value_type) << ", not " << valueTypeName(this->vtype) << ")";
+        }
+        std::cout << "\033[0m" << std::endl;
+        munmap(addr, len);
+        return -2;
+    }
+
+    clear();
+    this->map_addr = addr;
+    this->map_len = len;
+    this->base_count = header->count;
+    this->base_keys = (const uint64_t *) ((char *) addr + header->keys_offset);
+    this->base_values = (uint8_t *) addr + header->values_offset;
+    if (meta) {
+        memcpy(meta, header->meta, sizeof(header->meta));
+    }
+    return (long) this->base_count;
+}
+
+
+/**
+ * Drop the loaded file mapping
+ * @return void
+ */
+void QTable::unmap() {
+    if (this->map_addr) {
+        munmap(this->map_addr, this->map_len);
+    }
+    this->map_addr = nullptr;
+    this->map_len = 0;
+    this->base_keys = nullptr;
+    this->base_values = nullptr;
+    this->base_count = 0;
+}
+
+
+/**
+ * Remove every state, keeping the allocated capacity
+ * @return void
+ */
+void QTable::clear() {
+    this->ct_version++;
+    unmap();
+    std::fill(this->keys.begin(), this->keys.end(), EMPTY_KEY);
+    this->count = 0;
+}
+
+
+size_t QTable::size() {
+    return this->count + this->base_count;
+}
+
+
+int QTable::growths() {
+    return this->ct_growths;
+}
+
+
+size_t QTable::bytes() {
+    return this->keys.size() * slotBytes() + this->map_len;
+}
+
+
+/**
+ * Bytes of one hash table slot: key, rewards and visit count
+ */
+size_t QTable::slotBytes() {
+    return sizeof(uint64_t) + this->stride + sizeof(uint8_t);
+}
+
+
+/**
+ * Cap the bytes of the hash table (see header)
+ * @param max_bytes the budget, 0 for none
+ * @return void
+ */
+void QTable::setMaxBytes(size_t max_bytes) {
+    this->max_bytes = max_bytes;
+}
+
+
+size_t QTable::maxBytes() {
+    return this->max_bytes;
+}
+
+
+size_t QTable::evictions() {
+    return this->ct_evictions;
+}
+
+
+int QTable::width() const {
+    return this->w;
+}
+
+
+uint32_t QTable::valueType() const {
+    return this->vtype;
+}
+
+
+/**
+ * @return the table's version, see qtable.h
+ */
+uint64_t QTable::version() const {
+    return this->ct_version;
+}
+
+
+/**
+ * Name of a value type, as the command line gives it
+ * @return "f32", "i16" or "f16"
+ */
+const char * QTable::valueTypeName(uint32_t value_type) {
+    if (value_type == VALUE_INT16) {
+        return "i16";
+    } else if (value_type == VALUE_FLOAT16) {
+        return "f16";
+    }
+    return "f32";
+}
+
+
+/**
+ * Value type of a name given by valueTypeName
+ * @return the VALUE_* type, -1 if the name is not one
+ */
+int QTable::parseValueType(std::string name) {
+    for (uint32_t value_type = VALUE_FLOAT32; value_type <= VALUE_FLOAT16; value_type++) {
+        if (name == valueTypeName(value_type)) {
+            return (int) value_type;
+        }
+    }
+    return -1;
+}
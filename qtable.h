@@ -0,0 +1,376 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+/**
+ * On-disk layout of a saved QTable, native byte order. The header is
+ * followed by count sorted keys at keys_offset, and count * width
+ * rewards at values_offset (the rewards of keys[i] at i * width), each
+ * stored as value_type.
+ */
+struct QTableHeader {
+    // QTABLE_MAGIC
+    char magic[8];
+    // QTABLE_VERSION
+    uint32_t version;
+    // Rewards per state (the filter size of the learner)
+    uint32_t width;
+    // Encoding of each reward, QTable::VALUE_FLOAT32 / INT16 / FLOAT16
+    uint32_t value_type;
+    // Key scheme of the learner that saved the table
+    uint32_t hash_scheme;
+    // Number of states
+    uint64_t count;
+    // Byte offset of the sorted key array
+    uint64_t keys_offset;
+    // Byte offset of the reward array
+    uint64_t values_offset;
+    // Free for the saver's use (0 when unused)
+    uint64_t meta[4];
+};
+
+static const char QTABLE_MAGIC[8] = {'Q', 'T', 'A', 'B', 'L', 'E', '\r', '\n'};
+static const uint32_t QTABLE_VERSION = 1;
+
+
+/**
+ * QTable class
+ *
+ * A QTable maps 64-bit state keys to a fixed number of rewards.
+ * It is an open-addressing (Robin Hood, linear probe) hash table: keys
+ * sit in one array and the rewards of slot i sit inline at
+ * values[i * width], so a lookup touches one key and one reward run.
+ *
+ * The hash table can be held to a memory budget (setMaxBytes). Each
+ * state keeps a saturating visit count, bumped by every lookup; once the
+ * table can't grow within the budget, each insert first evicts the least
+ * visited of a few randomly sampled states, halving the others' counts
+ * (LFU with aging). Loaded (mapped) states are never evicted.
+ *
+ * Rewards are stored as 32-bit floats, or as 16-bit fixed point or half
+ * floats to halve their memory. find returns a state's stored rewards,
+ * read and written as floats through get / set / read / write; writes to
+ * a 16-bit table saturate at the type's range rather than overflow.
+ *
+ * A table loaded from file keeps the file memory-mapped (copy on write)
+ * as a sorted base layer, found by binary search and updated in place.
+ * States not in the file go to the hash table.
+ *
+ * Pointers returned by findOrInsert stay valid until the next insert
+ * (which may grow the table or evict the state).
+ */
+
+class QTable {
+    public:
+        // Reserved key marking an empty slot, never a valid state key
+        static constexpr uint64_t EMPTY_KEY = ~0ULL;
+        // Reward encodings for QTableHeader::value_type
+        static const uint32_t VALUE_FLOAT32 = 0;
+        // int16 fixed point, INT16_SCALE steps per reward unit
+        static const uint32_t VALUE_INT16 = 1;
+        // IEEE half precision
+        static const uint32_t VALUE_FLOAT16 = 2;
+        // Steps per reward unit of VALUE_INT16, a range of +-2048
+        static constexpr float INT16_SCALE = 16;
+
+        /**
+         * QTable Constructor
+         * @param width the number of rewards stored per state
+         * @param value_type how each reward is stored, VALUE_*
+         */
+        QTable(int width, uint32_t value_type = VALUE_FLOAT32);
+
+        /**
+         * QTable Destructor, unmaps any loaded file
+         */
+        ~QTable();
+
+        QTable(const QTable &) = delete;
+        QTable & operator=(const QTable &) = delete;
+
+        /**
+         * Find the rewards for a state, counting a visit (see above)
+         * @param key the state key
+         * @return the state's stored rewards, nullptr if not present
+         */
+        void * find(uint64_t key);
+
+        /**
+         * Find the rewards for a state without counting a visit, so
+         * threads may peek at a table no thread is changing
+         * @param key the state key
+         * @return the state's stored rewards, nullptr if not present
+         */
+        const void * peek(uint64_t key) const;
+
+        /**
+         * Find the rewards for a state, inserting it if absent. New
+         * rewards are zeroed for the caller to initialize.
+         * @param key the state key
+         * @param inserted set true iff the state was just inserted
+         * @return the state's stored rewards
+         */
+        void * findOrInsert(uint64_t key, bool & inserted);
+
+        /**
+         * Start loading the slot a state hashes to into cache, ahead of
+         * looking it up
+         * @param key the state key
+         * @return void
+         */
+        void prefetch(uint64_t key);
+
+        /**
+         * Sort key placing states in table order: lookups of states
+         * sorted by it walk the hash table front to back. The top bits
+         * are the home slot at any table size.
+         * @param key the state key
+         * @return the sort key
+         */
+        uint64_t order(uint64_t key) const;
+
+        /**
+         * Read one stored reward
+         * @param rewards a state's rewards from this table
+         * @param i the action
+         * @return the reward
+         */
+        float get(const void * rewards, int i) const;
+
+        /**
+         * Write one stored reward, saturating on a 16-bit table
+         * @param rewards a state's rewards from this table
+         * @param i the action
+         * @param reward the new reward
+         * @return void
+         */
+        void set(void * rewards, int i, float reward);
+
+        /**
+         * Read all of a state's rewards
+         * @param rewards a state's rewards from this table
+         * @param out set to the width rewards
+         * @return void
+         */
+        void read(const void * rewards, float * out) const;
+
+        /**
+         * Write all of a state's rewards, saturating on a 16-bit table
+         * @param rewards a state's rewards from this table
+         * @param in the width new rewards
+         * @return void
+         */
+        void write(void * rewards, const float * in);
+
+        /**
+         * Call f(key, rewards) for every state, loaded ones first, with
+         * the stored rewards as find returns them
+         * @return void
+         */
+        template <typename F>
+        void forEach(F f);
+
+        /**
+         * Write every state to a file, sorted by key. Written to
+         * fname.tmp then renamed over fname, so a crash never leaves a
+         * partial table behind.
+         * @param fname the file to write
+         * @param hash_scheme the key scheme of the caller, checked on load
+         * @param meta saved in the header for the caller, may be nullptr
+         * @return the number of states written, -1 on file error
+         */
+        long save(std::string fname, uint32_t hash_scheme, const uint64_t * meta);
+
+        /**
+         * Replace this table with one saved by save. The file is mapped,
+         * not parsed, so loading is near instant at any size.
+         * @param fname the file to read
+         * @param hash_scheme the key scheme of the caller
+         * @param meta set to the header's caller data, may be nullptr
+         * @return the number of states, -1 if the file can't be opened,
+         * -2 if it is not a table or was saved with a different filter
+         * size / value type / hash scheme (message printed)
+         */
+        long load(std::string fname, uint32_t hash_scheme, uint64_t * meta);
+
+        /**
+         * Remove every state, keeping the allocated capacity
+         * @return void
+         */
+        void clear();
+
+        /**
+         * @return the number of states held
+         */
+        size_t size();
+
+        /**
+         * @return the bytes allocated for keys, rewards and visit counts,
+         * including a mapped file
+         */
+        size_t bytes();
+
+        /**
+         * @return the number of times the table has been grown, the
+         * only point where it allocates
+         */
+        int growths();
+
+        /**
+         * Cap the bytes of the hash table (keys, rewards and visit
+         * counts, not a loaded file). The table grows by doubling while
+         * it fits the budget, then evicts a state per insert once full.
+         * A growth briefly holds the old arrays too.
+         * @param max_bytes the budget, 0 for none
+         * @return void
+         */
+        void setMaxBytes(size_t max_bytes);
+
+        /**
+         * @return the budget set by setMaxBytes, 0 for none
+         */
+        size_t maxBytes();
+
+        /**
+         * @return the number of states evicted to stay within budget
+         */
+        size_t evictions();
+
+        /**
+         * A count bumped by every call that may change the table or hand
+         * out rewards to change (find, findOrInsert, clear, load), so a
+         * reader can tell its view of the table is still current
+         * @return the table's version
+         */
+        uint64_t version() const;
+
+        /**
+         * @return the number of rewards per state
+         */
+        int width() const;
+
+        /**
+         * @return how each reward is stored, VALUE_*
+         */
+        uint32_t valueType() const;
+
+        /**
+         * Name of a value type, as the command line gives it
+         * @return "f32", "i16" or "f16"
+         */
+        static const char * valueTypeName(uint32_t value_type);
+
+        /**
+         * Value type of a name given by valueTypeName
+         * @return the VALUE_* type, -1 if the name is not one
+         */
+        static int parseValueType(std::string name);
+
+    private:
+        // State keys, EMPTY_KEY when free
+        std::vector<uint64_t> keys;
+        // Stored rewards, width per slot
+        std::vector<uint8_t> values;
+        // Number of states held in the hash table
+        size_t count;
+        // Rewards per state
+        int w;
+        // How each reward is stored / bytes of a state's rewards
+        uint32_t vtype;
+        size_t stride;
+        // log2 of the slot count
+        int bits;
+        // Times grown
+        int ct_growths;
+        // Visit count of each slot, saturating at 255
+        std::vector<uint8_t> visits;
+        // See version
+        uint64_t ct_version;
+        // Rewards of the entry being moved during an insert
+        std::vector<uint8_t> carry;
+        // Budget of the hash table in bytes, 0 for none
+        size_t max_bytes;
+        // States evicted so far
+        size_t ct_evictions;
+        // Random state of the eviction sampler (xorshift64)
+        uint64_t evict_rand;
+
+        // Loaded file mapping, nullptr when nothing is loaded
+        void * map_addr;
+        size_t map_len;
+        // Sorted keys / rewards of the loaded file (inside the mapping)
+        const uint64_t * base_keys;
+        uint8_t * base_values;
+        size_t base_count;
+
+        /**
+         * Home slot of a key
+         */
+        size_t home(uint64_t key) const;
+
+        /**
+         * Double the slot count and reinsert every state
+         * @return void
+         */
+        void grow();
+
+        /**
+         * Drop the loaded file mapping
+         * @return void
+         */
+        void unmap();
+
+        /**
+         * find / peek
+         * @param slot set to the state's hash table slot, NO_SLOT if it
+         * is in the loaded file or not present
+         */
+        const uint8_t * lookup(uint64_t key, size_t & slot) const;
+
+        // lookup's slot for states outside the hash table
+        static constexpr size_t NO_SLOT = ~(size_t) 0;
+
+        /**
+         * Evict the least visited of a few random states
+         * @return void
+         */
+        void evictOne();
+
+        /**
+         * Empty a slot, shifting the rest of its probe run back one
+         * @return void
+         */
+        void erase(size_t slot);
+
+        /**
+         * Bytes per hash table slot
+         */
+        size_t slotBytes();
+
+        /**
+         * Encode / decode a half precision float (F16C when available)
+         */
+        static uint16_t toHalf(float value);
+        static float fromHalf(uint16_t half);
+};
+
+
+/**
+ * Call f(key, rewards) for every state, loaded ones first
+ * @return void
+ */
+template <typename F>
+void QTable::forEach(F f) {
+    for (size_t i = 0; i < this->base_count; i++) {
+        f(this->base_keys[i], (void *) (this->base_values + i * this->stride));
+    }
+    for (size_t slot = 0; slot < this->keys.size(); slot++) {
+        if (this->keys[slot] != EMPTY_KEY) {
+            f(this->keys[slot], (void *) &this->values[slot * this->stride]);
+        }
+    }
+}
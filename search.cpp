@@ -0,0 +1,229 @@
+#include "search.h"
+#include <algorithm>
+#include <cmath>
+
+/**
+ * Search, see search.h.
+ */
+
+
+/**
+ * Count one more search
+ * @return void
+ */
+void SearchTotals::add(const SearchStats & stats) {
+    this->moves++;
+    this->nodes += stats.nodes;
+    this->secs += stats.secs;
+    this->depths += stats.depth;
+    this->max_depth = std::max(this->max_depth, stats.depth);
+}
+
+
+/**
+ * Count many more searches
+ * @return void
+ */
+void SearchTotals::add(const SearchTotals & totals) {
+    this->moves += totals.moves;
+    this->nodes += totals.nodes;
+    this->secs += totals.secs;
+    this->depths += totals.depths;
+    this->max_depth = std::max(this->max_depth, totals.max_depth);
+}
+
+
+/**
+ * QSearch Constructor
+ */
+template <int N>
+QSearch<N>::QSearch(const QPolicy<N> * policy, size_t tt_entries) {
+    this->policy = policy;
+    size_t n = 1024;
+    while (n < tt_entries) {
+        n <<= 1;
+    }
+    this->tt.resize(n);
+    this->tt_shift = 64 - __builtin_ctzll(n);
+    clear();
+}
+
+
+/**
+ * Forget the transposition table and history (a new game)
+ * @return void
+ */
+template <int N>
+void QSearch<N>::clear() {
+    TTEntry empty = {~0ULL, 0, 0, EXACT, -1};
+    std::fill(this->tt.begin(), this->tt.end(), empty);
+    std::fill(&this->history[0][0], &this->history[0][0] + 2 * 7, 0);
+}
+
+
+/**
+ * The searched move for player 1 on a position given as bitboards:
+ * iterative deepening from depth 1 until the budget runs out, a depth
+ * cut short is thrown away. The greedy move stands in should not even
+ * depth 1 finish.
+ * @return the column to drop in, -1 if the board is full
+ */
+template <int N>
+int QSearch<N>::selectMove(uint64_t position, uint64_t mask, int move_ms, int max_depth, SearchStats * stats) {
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    if (!Game::legalMoves(mask)) {
+        return -1;
+    }
+    this->nodes = 0;
+    this->stopped = false;
+    this->timed = move_ms > 0;
+    this->deadline = begin + std::chrono::milliseconds(move_ms);
+    // older cut-offs count for less
+    for (int side = 0; side < 2; side++) {
+        for (int c = 0; c < 7; c++) {
+            this->history[side][c] /= 2;
+        }
+    }
+
+    float score = 0;
+    int move = this->policy->selectMove(position, mask, &score);
+    int depth = 0;
+    int empty = 42 - __builtin_popcountll(mask);
+    for (int d = 1; d <= std::min(max_depth, empty); d++) {
+        int best = -1;
+        float value = negamax(position, mask, d, -2 * WIN_SCORE, 2 * WIN_SCORE, best);
+        if (this->stopped) {
+            break;
+        }
+        move = best;
+        score = value;
+        depth = d;
+        // a forced win or loss is as good as it gets
+        if (std::fabs(value) > WIN_SCORE - 64) {
+            break;
+        }
+    }
+
+    if (stats) {
+        std::chrono::duration<double> t = std::chrono::steady_clock::now() - begin;
+        stats->nodes = this->nodes;
+        stats->depth = depth;
+        stats->secs = t.count();
+        stats->score = score;
+    }
+    return move;
+}
+
+
+/**
+ * Negamax with alpha-beta on a position seen by the side to move. A win
+ * scores WIN_SCORE less the pieces on the board after it, the same from
+ * any root, so transposition table entries hold across moves.
+ * @return the position's score for the side to move
+ */
+template <int N>
+float QSearch<N>::negamax(uint64_t position, uint64_t mask, int depth, float alpha, float beta, int & best) {
+    best = -1;
+    this->nodes++;
+    if (this->timed && (this->nodes & 1023) == 0 && std::chrono::steady_clock::now() >= this->deadline) {
+        this->stopped = true;
+    }
+    if (this->stopped) {
+        return 0;
+    }
+    uint32_t legal = Game::legalMoves(mask);
+    if (!legal) {
+        // a full board is a tie
+        return 0;
+    }
+
+    // the bit each legal drop sets, and whether it wins on the spot
+    uint64_t drops[7];
+    for (int c = 0; c < 7; c++) {
+        if ((legal >> c) & 1) {
+            drops[c] = (mask + (1ULL << (c * 7))) & (0x3fULL << (c * 7));
+            if (Game::alignment(position | drops[c])) {
+                best = c;
+                return WIN_SCORE - (__builtin_popcountll(mask) + 1);
+            }
+        }
+    }
+
+    if (depth == 0) {
+        // the table's say. Rewards grow without bound over long training
+        // (up to inf), a signed log keeps their order on a scale far short
+        // of a win
+        float reward = 0;
+        best = this->policy->selectMove(position, mask, &reward);
+        if (std::isnan(reward)) {
+            return 0;
+        }
+        return std::copysign(std::min(std::log1p(std::fabs(reward)), HORIZON_SCORE), reward);
+    }
+
+    uint64_t key = DecisionCache::positionKey(position, mask);
+    TTEntry & e = entry(key);
+    int tt_move = -1;
+    if (e.key == key) {
+        tt_move = e.move;
+        if (e.depth >= depth && (e.bound == EXACT || (e.bound == LOWER && e.value >= beta) ||
+                                 (e.bound == UPPER && e.value <= alpha))) {
+            best = e.move;
+            return e.value;
+        }
+    }
+
+    // the transposition table's move, then by history, then center first
+    static const int center[7] = {3, 2, 4, 1, 5, 0, 6};
+    int side = __builtin_popcountll(mask) & 1;
+    int order[7];
+    int n = 0;
+    for (int c : center) {
+        if ((legal >> c) & 1) {
+            order[n++] = c;
+        }
+    }
+    std::stable_sort(order, order + n, [&](int a, int b) {
+        if (a == tt_move || b == tt_move) {
+            return a == tt_move && b != tt_move;
+        }
+        return this->history[side][a] > this->history[side][b];
+    });
+
+    float alpha_in = alpha;
+    float value = -2 * WIN_SCORE;
+    for (int i = 0; i < n; i++) {
+        int c = order[i];
+        int reply;
+        // the opponent's view: its pieces are the rest of the board
+        float score = -negamax(position ^ mask, mask | drops[c], depth - 1, -beta, -alpha, reply);
+        if (this->stopped) {
+            return 0;
+        }
+        if (score > value) {
+            value = score;
+            best = c;
+        }
+        alpha = std::max(alpha, value);
+        if (alpha >= beta) {
+            this->history[side][c] += depth * depth;
+            break;
+        }
+    }
+
+    e.key = key;
+    e.value = value;
+    e.depth = (int8_t) depth;
+    e.bound = value <= alpha_in ? UPPER : value >= beta ? LOWER : EXACT;
+    e.move = (int8_t) best;
+    return value;
+}
+
+
+/**
+ * @return the transposition table entry of a key
+ */
+template <int N>
+typename QSearch<N>::TTEntry & QSearch<N>::entry(uint64_t key) {
+    return this->tt[(key * 0x9e3779b97f4a7c15ULL) >> this->tt_shift];
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include "game.h"
+#include "policy.h"
+
+
+/**
+ * Search
+ *
+ * Looks further ahead than the one ply of greedy play: negamax with
+ * alpha-beta pruning, deepened one ply at a time until a per-move time
+ * budget runs out, the last fully searched depth giving the move.
+ * Positions at the search horizon are scored by the Q table, the best
+ * reward of the side to move over its windows (QPolicy::selectMove, on a
+ * log scale), and
+ * wins are scored exactly (sooner is better), so a search never misses a
+ * win or a block within its depth.
+ *
+ * A transposition table (direct mapped by exact position, always
+ * replaced) keeps each searched position's bound and best move, which is
+ * tried first when the position comes up again, in this or a deeper
+ * iteration or on a later move. The other moves are tried by their
+ * history score (bumped by every cut-off a move makes, halved every
+ * move) and then center first.
+ *
+ * A QSearch is used by one thread at a time; searches on other threads
+ * need their own, all may share one policy.
+ */
+
+/**
+ * What a search did
+ */
+struct SearchStats {
+    // Positions visited
+    long nodes = 0;
+    // Deepest iteration completed, in plies
+    int depth = 0;
+    // Wall clock time of the search
+    double secs = 0;
+    // Score of the move for the side to move (wins are near WIN_SCORE)
+    float score = 0;
+};
+
+/**
+ * What many searches did, summed
+ */
+struct SearchTotals {
+    long moves = 0;
+    long nodes = 0;
+    double secs = 0;
+    // Sum and deepest of the depths completed
+    long depths = 0;
+    int max_depth = 0;
+
+    /**
+     * Count one more search
+     * @param stats what it did
+     * @return void
+     */
+    void add(const SearchStats & stats);
+
+    /**
+     * Count many more searches
+     * @param totals what they did
+     * @return void
+     */
+    void add(const SearchTotals & totals);
+};
+
+
+template <int N>
+class QSearch {
+    public:
+        // Score of a win on an empty board, less one per piece on the
+        // board once it is won (sooner wins score higher)
+        static constexpr float WIN_SCORE = 1e6f;
+        // Largest score of a position at the horizon, either way
+        static constexpr float HORIZON_SCORE = 100;
+
+        /**
+         * QSearch Constructor
+         * @param policy the policy scoring the horizon, must outlive this
+         * @param tt_entries transposition table size, rounded up to a
+         * power of 2 (16 bytes each)
+         */
+        QSearch(const QPolicy<N> * policy, size_t tt_entries = 1 << 18);
+
+        QSearch(const QSearch &) = delete;
+        QSearch & operator=(const QSearch &) = delete;
+
+        /**
+         * The searched move for player 1 (the player the table was
+         * trained as) on a position given as bitboards; swap the colors
+         * (position ^ mask) to move for player -1
+         * @param position bitboard of player 1's pieces
+         * @param mask bitboard of every occupied cell
+         * @param move_ms time budget in milliseconds, 0 for none (then
+         * max_depth must bound the search)
+         * @param max_depth deepest iteration, in plies
+         * @param stats set to what the search did, may be nullptr
+         * @return the column to drop in, -1 if the board is full
+         */
+        int selectMove(uint64_t position, uint64_t mask, int move_ms, int max_depth = 42,
+                       SearchStats * stats = nullptr);
+
+        /**
+         * Forget the transposition table and history (a new game)
+         * @return void
+         */
+        void clear();
+
+    private:
+        /**
+         * A transposition table entry, 16 bytes
+         */
+        struct TTEntry {
+            // positionKey of the side to move's view, ~0 when empty
+            uint64_t key;
+            float value;
+            int8_t depth;
+            // EXACT, LOWER or UPPER bound
+            int8_t bound;
+            int8_t move;
+        };
+
+        static const int8_t EXACT = 0;
+        static const int8_t LOWER = 1;
+        static const int8_t UPPER = 2;
+
+        // The policy scoring the horizon
+        const QPolicy<N> * policy;
+        std::vector<TTEntry> tt;
+        // 64 - log2(tt.size())
+        int tt_shift;
+        // Cut-offs made by each column, by side to move (pieces on the
+        // board even or odd)
+        long history[2][7];
+        // The search in progress
+        long nodes;
+        bool stopped;
+        bool timed;
+        std::chrono::steady_clock::time_point deadline;
+
+        /**
+         * Negamax with alpha-beta on a position seen by the side to move
+         * @param position bitboard of the side to move's pieces
+         * @param mask bitboard of every occupied cell
+         * @param depth plies left to the horizon
+         * @param alpha the score the side to move already has elsewhere
+         * @param beta the score the opponent already has elsewhere
+         * @param best set to the best move found (the root's answer)
+         * @return the position's score for the side to move, meaningless
+         * once the search is stopped
+         */
+        float negamax(uint64_t position, uint64_t mask, int depth, float alpha, float beta, int & best);
+
+        /**
+         * @return the transposition table entry of a key
+         */
+        TTEntry & entry(uint64_t key);
+};
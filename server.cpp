@@ -0,0 +1,407 @@
+#include "server.h"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/**
+ * Move server, see server.h.
+ */
+
+
+template <int N>
+std::atomic<bool> MoveServer<N>::stopping(false);
+
+
+/**
+ * MoveServer Constructor
+ */
+template <int N>
+MoveServer<N>::MoveServer(const QPolicy<N> * policy, std::string path, int n_threads, int max_batch, int report_secs) {
+    this->policy = policy;
+    this->path = path;
+    this->listen_fd = -1;
+    this->bound = false;
+    this->max_batch = std::max(1, max_batch);
+    this->report_secs = report_secs;
+    for (int t = 0; t < std::max(1, n_threads); t++) {
+        Worker * w = new Worker();
+        w->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        w->requests = 0;
+        w->batches = 0;
+        this->workers.push_back(w);
+    }
+}
+
+
+/**
+ * MoveServer Destructor, closes the socket and removes its path
+ */
+template <int N>
+MoveServer<N>::~MoveServer() {
+    for (Worker * w : this->workers) {
+        for (Connection * conn : w->conns) {
+            close(conn->fd);
+            delete conn;
+        }
+        close(w->epoll_fd);
+        delete w;
+    }
+    if (this->listen_fd >= 0) {
+        close(this->listen_fd);
+    }
+    // only ever the socket this server bound
+    if (this->bound) {
+        unlink(this->path.c_str());
+    }
+}
+
+
+/**
+ * Serve moves until SIGINT / SIGTERM (or stop)
+ * @return 0 on a clean stop, -1 if the socket can't be listened on
+ */
+template <int N>
+int MoveServer<N>::run() {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (this->path.size() >= sizeof(addr.sun_path)) {
+        std::cout << "\033[1;31mSOCKET PATH TOO LONG: " << this->path << "\033[0m" << std::endl;
+        return -1;
+    }
+    strncpy(addr.sun_path, this->path.c_str(), sizeof(addr.sun_path) - 1);
+    if (claimPath(addr)) {
+        return -1;
+    }
+    this->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (this->listen_fd < 0 || bind(this->listen_fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        std::cout << "\033[1;31mCAN'T LISTEN ON " << this->path << ": " << strerror(errno) << "\033[0m" << std::endl;
+        return -1;
+    }
+    this->bound = true;
+    if (listen(this->listen_fd, SOMAXCONN) != 0) {
+        std::cout << "\033[1;31mCAN'T LISTEN ON " << this->path << ": " << strerror(errno) << "\033[0m" << std::endl;
+        return -1;
+    }
+
+    // no SA_RESTART, so a signal also wakes the accept loop
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onSignal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    stopping = false;
+
+    for (Worker * w : this->workers) {
+        w->thread = std::thread([this, w]() { serve(w); });
+    }
+    std::cout << "\033[1;36mSERVING: \033[0m" << this->path << " on " << this->workers.size() << " threads" << std::endl;
+
+    size_t next = 0;
+    std::chrono::steady_clock::time_point last_report = std::chrono::steady_clock::now();
+    while (!stopping) {
+        struct pollfd listening = {this->listen_fd, POLLIN, 0};
+        if (poll(&listening, 1, 100) > 0) {
+            int fd = accept4(this->listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd >= 0) {
+                // connections are dealt to the workers in turn
+                Worker * w = this->workers[next++ % this->workers.size()];
+                Connection * conn = new Connection();
+                conn->fd = fd;
+                conn->writing = false;
+                {
+                    std::lock_guard<std::mutex> guard(w->lock);
+                    w->conns.push_back(conn);
+                }
+                struct epoll_event event;
+                memset(&event, 0, sizeof(event));
+                event.events = EPOLLIN;
+                event.data.ptr = conn;
+                epoll_ctl(w->epoll_fd, EPOLL_CTL_ADD, fd, &event);
+            }
+        }
+        std::chrono::duration<double> t = std::chrono::steady_clock::now() - last_report;
+        if (this->report_secs && t.count() >= this->report_secs) {
+            report();
+            last_report = std::chrono::steady_clock::now();
+        }
+    }
+
+    for (Worker * w : this->workers) {
+        w->thread.join();
+    }
+    std::cout << std::endl << "\033[1;36mSTOP SERVING\033[0m" << std::endl;
+    report();
+    return 0;
+}
+
+
+/**
+ * Make sure the socket path is free to bind, removing a stale socket
+ * @return 0 if the path can be bound, -1 if not (printed)
+ */
+template <int N>
+int MoveServer<N>::claimPath(const struct sockaddr_un & addr) {
+    struct stat st;
+    if (lstat(this->path.c_str(), &st) != 0) {
+        if (errno == ENOENT) {
+            return 0;
+        }
+        std::cout << "\033[1;31mCAN'T LISTEN ON " << this->path << ": " << strerror(errno) << "\033[0m" << std::endl;
+        return -1;
+    }
+    if (!S_ISSOCK(st.st_mode)) {
+        std::cout << "\033[1;31mNOT A SOCKET, LEFT ALONE: " << this->path << "\033[0m" << std::endl;
+        return -1;
+    }
+    // a socket still answering belongs to a live server
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        std::cout << "\033[1;31mCAN'T LISTEN ON " << this->path << ": " << strerror(errno) << "\033[0m" << std::endl;
+        return -1;
+    }
+    int connected = connect(fd, (const struct sockaddr *) &addr, sizeof(addr));
+    int error = errno;
+    close(fd);
+    if (connected != 0 && error == ECONNREFUSED) {
+        unlink(this->path.c_str());
+        return 0;
+    }
+    if (connected == 0) {
+        std::cout << "\033[1;31mALREADY SERVING: " << this->path << "\033[0m" << std::endl;
+    } else {
+        std::cout << "\033[1;31mCAN'T LISTEN ON " << this->path << ": " << strerror(error) << "\033[0m" << std::endl;
+    }
+    return -1;
+}
+
+
+/**
+ * Make run return, safe to call from a signal handler
+ * @return void
+ */
+template <int N>
+void MoveServer<N>::stop() {
+    stopping = true;
+}
+
+
+/**
+ * Signal handler, calls stop
+ */
+template <int N>
+void MoveServer<N>::onSignal(int) {
+    stop();
+}
+
+
+/**
+ * A worker's loop: read, answer and reply until stopped
+ * @return void
+ */
+template <int N>
+void MoveServer<N>::serve(Worker * w) {
+    // latencies kept per report, the rest of a busy interval is counted only
+    const size_t max_latencies = 1 << 22;
+    std::vector<struct epoll_event> events(64);
+    std::vector<Connection *> replying;
+    while (!stopping) {
+        int ready = epoll_wait(w->epoll_fd, events.data(), (int) events.size(), 100);
+        if (ready <= 0) {
+            continue;
+        }
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        int answered = 0;
+        replying.clear();
+        for (int e = 0; e < ready; e++) {
+            Connection * conn = (Connection *) events[e].data.ptr;
+            uint32_t flags = events[e].events;
+            if ((flags & EPOLLOUT) && !flush(w, conn)) {
+                drop(w, conn);
+                continue;
+            }
+            if ((flags & (EPOLLERR | EPOLLHUP)) && !(flags & EPOLLIN)) {
+                drop(w, conn);
+                continue;
+            }
+            if (!(flags & EPOLLIN) || answered >= this->max_batch) {
+                // left for the next wakeup (epoll is level triggered)
+                continue;
+            }
+
+            // read no more than the rest of the batch
+            size_t have = conn->in.size();
+            size_t want = (this->max_batch - answered) * sizeof(MoveRequest) - have;
+            conn->in.resize(have + want);
+            ssize_t got = recv(conn->fd, conn->in.data() + have, want, 0);
+            if (got <= 0) {
+                conn->in.resize(have);
+                if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+                    continue;
+                }
+                drop(w, conn);
+                continue;
+            }
+            conn->in.resize(have + got);
+
+            int n_requests = (int) (conn->in.size() / sizeof(MoveRequest));
+            for (int r = 0; r < n_requests; r++) {
+                MoveRequest request;
+                memcpy(&request, conn->in.data() + r * sizeof(MoveRequest), sizeof(MoveRequest));
+                MoveReply reply = {request.id, answer(request)};
+                const uint8_t * bytes = (const uint8_t *) &reply;
+                conn->out.insert(conn->out.end(), bytes, bytes + sizeof(reply));
+            }
+            // a partial request waits for the rest of its bytes
+            conn->in.erase(conn->in.begin(), conn->in.begin() + n_requests * sizeof(MoveRequest));
+            answered += n_requests;
+            if (n_requests) {
+                replying.push_back(conn);
+            }
+        }
+        // one write per connection for the whole batch
+        for (Connection * conn : replying) {
+            if (!flush(w, conn)) {
+                drop(w, conn);
+            }
+        }
+
+        std::chrono::duration<double, std::nano> t = std::chrono::steady_clock::now() - begin;
+        if (answered) {
+            std::lock_guard<std::mutex> guard(w->lock);
+            size_t room = max_latencies - std::min(max_latencies, w->latencies.size());
+            w->latencies.insert(w->latencies.end(), std::min((size_t) answered, room), t.count());
+            w->requests += answered;
+            w->batches++;
+        }
+    }
+}
+
+
+/**
+ * The move for one request
+ * @return the column, -1 for a bad position
+ */
+template <int N>
+int MoveServer<N>::answer(const MoveRequest & request) {
+    if (!validBoard(request.position, request.mask)) {
+        return -1;
+    }
+    // the table was trained as player 1, so the side to move is shown as it
+    bool red_to_move = __builtin_popcountll(request.mask) % 2 == 0;
+    return this->policy->selectMove(red_to_move ? request.position : request.position ^ request.mask, request.mask);
+}
+
+
+/**
+ * Checks a request's bitboards are a position a game could reach
+ * @return true if the position is legal
+ */
+template <int N>
+bool MoveServer<N>::validBoard(uint64_t position, uint64_t mask) {
+    // 7 columns of 7 bits, the top bit of each is never set
+    if ((mask >> 49) || (position & ~mask)) {
+        return false;
+    }
+    for (int j = 0; j < 7; j++) {
+        uint64_t column = (mask >> (j * 7)) & 0x7f;
+        if ((column & 0x40) || (column & (column + 1))) {
+            return false;
+        }
+    }
+    int red = __builtin_popcountll(position);
+    int black = __builtin_popcountll(mask) - red;
+    return red == black || red == black + 1;
+}
+
+
+/**
+ * Send what a connection has waiting
+ * @return false if the connection failed
+ */
+template <int N>
+bool MoveServer<N>::flush(Worker * w, Connection * conn) {
+    size_t sent = 0;
+    while (sent < conn->out.size()) {
+        ssize_t n = send(conn->fd, conn->out.data() + sent, conn->out.size() - sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            if (errno != EINTR) {
+                return false;
+            }
+            continue;
+        }
+        sent += n;
+    }
+    conn->out.erase(conn->out.begin(), conn->out.begin() + sent);
+
+    // a client not reading its replies is not read from until it does
+    bool writing = !conn->out.empty();
+    if (writing != conn->writing) {
+        conn->writing = writing;
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = writing ? EPOLLOUT : EPOLLIN;
+        event.data.ptr = conn;
+        epoll_ctl(w->epoll_fd, EPOLL_CTL_MOD, conn->fd, &event);
+    }
+    return true;
+}
+
+
+/**
+ * Close a connection and forget it
+ * @return void
+ */
+template <int N>
+void MoveServer<N>::drop(Worker * w, Connection * conn) {
+    epoll_ctl(w->epoll_fd, EPOLL_CTL_DEL, conn->fd, nullptr);
+    close(conn->fd);
+    {
+        std::lock_guard<std::mutex> guard(w->lock);
+        w->conns.erase(std::find(w->conns.begin(), w->conns.end(), conn));
+    }
+    delete conn;
+}
+
+
+/**
+ * Print the requests answered and their p50 / p99 latency since the
+ * last report
+ * @return void
+ */
+template <int N>
+void MoveServer<N>::report() {
+    std::vector<double> latencies;
+    long requests = 0;
+    long batches = 0;
+    for (Worker * w : this->workers) {
+        std::lock_guard<std::mutex> guard(w->lock);
+        latencies.insert(latencies.end(), w->latencies.begin(), w->latencies.end());
+        w->latencies.clear();
+        requests += w->requests;
+        batches += w->batches;
+        w->requests = 0;
+        w->batches = 0;
+    }
+    std::cout << "\033[1;36mSERVED: \033[0m" << requests << " requests";
+    if (requests) {
+        // nearest rank percentiles
+        std::sort(latencies.begin(), latencies.end());
+        double p50 = latencies[(latencies.size() - 1) * 50 / 100];
+        double p99 = latencies[(latencies.size() - 1) * 99 / 100];
+        std::cout << " in " << batches << " batches (" << (double) requests / batches << " per batch), ";
+        std::cout << "p50 " << p50 / 1000 << " us, p99 " << p99 / 1000 << " us";
+    }
+    std::cout << std::endl;
+}
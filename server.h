@@ -0,0 +1,194 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/un.h>
+#include "game.h"
+#include "policy.h"
+
+
+/**
+ * Move server
+ *
+ * Serves greedy moves from one loaded Q table over a Unix domain stream
+ * socket. A client sends fixed size requests (MoveRequest) and gets one
+ * fixed size reply (MoveReply) per request, in order; requests may be
+ * pipelined, and any number of clients may be connected. Integers are in
+ * the host's byte order (the socket is local).
+ *
+ * The accepting thread hands each connection to one of n_threads worker
+ * threads. A worker waits on all its connections at once (epoll) and
+ * answers everything that arrived in one wakeup as a batch (at most
+ * max_batch requests), replying to each connection with a single write.
+ * The table is mapped once and every worker plays the same QPolicy, so
+ * it is never copied or written.
+ *
+ * The time from the wakeup that read a request to its reply being sent
+ * is kept (for the first 4M requests per worker per report), and its
+ * p50 / p99 printed every report_secs and on shutdown.
+ */
+
+/**
+ * A request for a move, 24 bytes
+ */
+struct MoveRequest {
+    // Echoed in the reply
+    uint32_t id;
+    // 0
+    uint32_t reserved;
+    // Bitboards of the position as Game::getPosition / Game::getMask:
+    // player 1's (the first mover's) pieces and all pieces, 7 bits per
+    // column from the bottom. The side to move follows from the count.
+    uint64_t position;
+    uint64_t mask;
+};
+
+/**
+ * The answer to a request, 8 bytes
+ */
+struct MoveReply {
+    // The request's id
+    uint32_t id;
+    // The column to drop in (0-6), -1 if the board is not a legal
+    // position or is full
+    int32_t column;
+};
+
+static_assert(sizeof(MoveRequest) == 24, "MoveRequest is 24 bytes on the wire");
+static_assert(sizeof(MoveReply) == 8, "MoveReply is 8 bytes on the wire");
+
+
+template <int N>
+class MoveServer {
+    public:
+        /**
+         * MoveServer Constructor
+         * @param policy the policy to answer with, shared by the workers
+         * @param path the socket path, a stale socket there is replaced (see run)
+         * @param n_threads worker threads
+         * @param max_batch requests answered per worker wakeup at most
+         * @param report_secs seconds between latency reports, 0 for none
+         * (one is still printed on shutdown)
+         */
+        MoveServer(const QPolicy<N> * policy, std::string path, int n_threads, int max_batch, int report_secs);
+
+        /**
+         * MoveServer Destructor, closes the socket and removes its path
+         * if this server bound it
+         */
+        ~MoveServer();
+
+        /**
+         * Serve moves until SIGINT / SIGTERM (or stop)
+         * @return 0 on a clean stop, -1 if the socket can't be listened on
+         * (the path is not a socket, or a server is listening on it)
+         */
+        int run();
+
+        /**
+         * Make run return, safe to call from a signal handler
+         * @return void
+         */
+        static void stop();
+
+        /**
+         * Checks a request's bitboards are a position a game could reach
+         * (ignoring wins): columns filled from the bottom, player 1 on as
+         * many cells as player -1 or one more
+         * @return true if the position is legal
+         */
+        static bool validBoard(uint64_t position, uint64_t mask);
+
+    private:
+        /**
+         * A client connection, owned by one worker
+         */
+        struct Connection {
+            int fd;
+            // Received bytes not yet answered (a partial request)
+            std::vector<uint8_t> in;
+            // Replies not yet sent (the client is slow to read)
+            std::vector<uint8_t> out;
+            // true while waiting for the socket to take out
+            bool writing;
+        };
+
+        /**
+         * A worker thread and its connections
+         */
+        struct Worker {
+            int epoll_fd;
+            std::thread thread;
+            // Guards conns (added by the accepting thread) and the stats
+            std::mutex lock;
+            std::vector<Connection *> conns;
+            // Latency of each request answered since the last report, ns
+            std::vector<double> latencies;
+            long requests;
+            long batches;
+        };
+
+        // Set by stop, checked by every thread
+        static std::atomic<bool> stopping;
+        // The policy answering
+        const QPolicy<N> * policy;
+        // The socket path and listening socket
+        std::string path;
+        int listen_fd;
+        // true once path is this server's socket (bound), to remove it
+        bool bound;
+        std::vector<Worker *> workers;
+        int max_batch;
+        int report_secs;
+
+        /**
+         * Make sure the socket path is free to bind: nothing there, or a
+         * socket no server is listening on (left by a server that died),
+         * which is removed. Anything else is left alone.
+         * @param addr the socket address of path
+         * @return 0 if the path can be bound, -1 if not (printed)
+         */
+        int claimPath(const struct sockaddr_un & addr);
+
+        /**
+         * A worker's loop: read, answer and reply until stopped
+         * @return void
+         */
+        void serve(Worker * w);
+
+        /**
+         * The move for one request
+         * @return the column, -1 for a bad position
+         */
+        int answer(const MoveRequest & request);
+
+        /**
+         * Send what a connection has waiting, watching for the socket to
+         * take more if not all of it went
+         * @return false if the connection failed
+         */
+        bool flush(Worker * w, Connection * conn);
+
+        /**
+         * Close a connection and forget it
+         * @return void
+         */
+        void drop(Worker * w, Connection * conn);
+
+        /**
+         * Print the requests answered and their p50 / p99 latency since
+         * the last report
+         * @return void
+         */
+        void report();
+
+        /**
+         * Signal handler, calls stop
+         */
+        static void onSignal(int);
+};
@@ -0,0 +1,284 @@
+#include "tablebase.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "game.h"
+
+/**
+ * Tablebase class
+ *
+ * Exact results of the positions a given number of cells from a full
+ * board, see tablebase.h.
+ */
+
+
+/**
+ * Tablebase Constructor, empty until load or probe
+ */
+Tablebase::Tablebase(int empty) {
+    this->n_empty = empty;
+    this->map_addr = nullptr;
+    this->map_len = 0;
+    this->base_keys = nullptr;
+    this->base_results = nullptr;
+    this->base_count = 0;
+    this->ct_probes = 0;
+    this->ct_solves = 0;
+}
+
+
+/**
+ * Tablebase Destructor, unmaps the loaded file
+ */
+Tablebase::~Tablebase() {
+    unmap();
+}
+
+
+/**
+ * The exact result of a position on the boundary, looked up in the file,
+ * then in the results solved this run, else solved
+ * @return true if the position has exactly empty() empty cells
+ */
+bool Tablebase::probe(uint64_t position, uint64_t mask, int & winner) {
+    if (42 - __builtin_popcountll(mask) != this->n_empty) {
+        return false;
+    }
+    this->ct_probes++;
+    uint64_t key = canonicalKey(position, mask);
+    uint8_t result;
+    const uint64_t * found = std::lower_bound(this->base_keys, this->base_keys + this->base_count, key);
+    if (found != this->base_keys + this->base_count && *found == key) {
+        size_t i = found - this->base_keys;
+        result = (this->base_results[i / 4] >> (i % 4 * 2)) & 3;
+    } else {
+        std::unordered_map<uint64_t, uint8_t>::iterator it = this->added.find(key);
+        if (it != this->added.end()) {
+            result = it->second;
+        } else {
+            // red moves on an even number of pieces
+            int red = __builtin_popcountll(mask) % 2 == 0 ? 1 : -1;
+            int score = solve(red == 1 ? position : position ^ mask, mask) * red;
+            result = score > 0 ? RED_WINS : score < 0 ? BLACK_WINS : TIE;
+            this->added[key] = result;
+            this->ct_solves++;
+        }
+    }
+    winner = result == RED_WINS ? 1 : result == BLACK_WINS ? -1 : 0;
+    return true;
+}
+
+
+/**
+ * Solve a position exactly
+ * @return 1 if the side to move wins, -1 if it loses, 0 on a tie
+ */
+int Tablebase::solve(uint64_t position, uint64_t mask) {
+    return negamax(position, mask, -1, 1);
+}
+
+
+/**
+ * Negamax with alpha-beta on results only, center columns first
+ * @return the result for the side to move
+ */
+int Tablebase::negamax(uint64_t position, uint64_t mask, int alpha, int beta) {
+    uint32_t legal = Game::legalMoves(mask);
+    if (!legal) {
+        return 0;
+    }
+    uint64_t drops[7];
+    for (int c = 0; c < 7; c++) {
+        if ((legal >> c) & 1) {
+            drops[c] = (mask + (1ULL << (c * 7))) & (0x3fULL << (c * 7));
+            if (Game::alignment(position | drops[c])) {
+                return 1;
+            }
+        }
+    }
+    static const int center[7] = {3, 2, 4, 1, 5, 0, 6};
+    int value = -1;
+    for (int c : center) {
+        if (!((legal >> c) & 1)) {
+            continue;
+        }
+        // the opponent's view: its pieces are the rest of the board
+        value = std::max(value, -negamax(position ^ mask, mask | drops[c], -beta, -alpha));
+        alpha = std::max(alpha, value);
+        if (alpha >= beta) {
+            break;
+        }
+    }
+    return value;
+}
+
+
+/**
+ * Key of a position and its mirror. position + mask is column by column
+ * (no carries between columns), so the mirror's key is the key's 7 bit
+ * columns in reverse order.
+ * @return the smaller of the two keys
+ */
+uint64_t Tablebase::canonicalKey(uint64_t position, uint64_t mask) {
+    uint64_t key = position + mask;
+    uint64_t mirror = 0;
+    for (int c = 0; c < 7; c++) {
+        mirror |= ((key >> (c * 7)) & 0x7f) << ((6 - c) * 7);
+    }
+    return std::min(key, mirror);
+}
+
+
+/**
+ * Map a file written by save
+ * @return the number of positions, -1 if the file can't be opened, -2 if
+ * it is not a tablebase of empty() empty cells
+ */
+long Tablebase::load(std::string fname) {
+    int fd = open(fname.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(TablebaseHeader)) {
+        close(fd);
+        std::cout << "\033[1;31m" << fname << " is not a tablebase\033[0m" << std::endl;
+        return -2;
+    }
+    size_t len = st.st_size;
+    void * addr = mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return -1;
+    }
+
+    const TablebaseHeader * header = (const TablebaseHeader *) addr;
+    const char * problem = nullptr;
+    if (memcmp(header->magic, TABLEBASE_MAGIC, sizeof(header->magic)) != 0) {
+        problem = "is not a tablebase";
+    } else if (header->version != TABLEBASE_VERSION) {
+        problem = "has an unsupported version";
+    } else if ((int) header->empty != this->n_empty) {
+        problem = "holds positions with a different number of empty cells";
+    } else if (header->keys_offset < sizeof(TablebaseHeader) || header->keys_offset > len ||
+               header->keys_offset % alignof(uint64_t) != 0 ||
+               header->results_offset < sizeof(TablebaseHeader) || header->results_offset > len) {
+        problem = "has a corrupt header";
+    } else if (header->count > (len - header->keys_offset) / sizeof(uint64_t) ||
+               header->count / 4 + (header->count % 4 != 0) > len - header->results_offset) {
+        // divided rather than multiplied, a huge count can't wrap around
+        problem = "is truncated";
+    }
+    if (problem) {
+        std::cout << "\033[1;31m" << fname << " " << problem;
+        if ((int) header->empty != this->n_empty && !memcmp(header->magic, TABLEBASE_MAGIC, sizeof(header->magic))) {
+            std::cout << " (" << header->empty << ", not " << this->n_empty << ")";
+        }
+        std::cout << "\033[0m" << std::endl;
+        munmap(addr, len);
+        return -2;
+    }
+
+    unmap();
+    this->added.clear();
+    this->map_addr = addr;
+    this->map_len = len;
+    this->base_count = header->count;
+    this->base_keys = (const uint64_t *) ((const char *) addr + header->keys_offset);
+    this->base_results = (const uint8_t *) addr + header->results_offset;
+    return (long) this->base_count;
+}
+
+
+/**
+ * Write every result, the loaded file's merged with the solved ones
+ * @return the number of positions written, -1 on file error
+ */
+long Tablebase::save(std::string fname) {
+    std::vector<std::pair<uint64_t, uint8_t>> solved(this->added.begin(), this->added.end());
+    std::sort(solved.begin(), solved.end());
+
+    TablebaseHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TABLEBASE_MAGIC, sizeof(header.magic));
+    header.version = TABLEBASE_VERSION;
+    header.empty = this->n_empty;
+    header.count = this->base_count + solved.size();
+    header.keys_offset = (sizeof(header) + 63) & ~63ULL;
+    header.results_offset = (header.keys_offset + header.count * sizeof(uint64_t) + 63) & ~63ULL;
+
+    // the merged order, results packed as it goes
+    std::vector<uint8_t> results((header.count + 3) / 4, 0);
+    std::string tmp = fname + ".tmp";
+    std::ofstream stream(tmp, std::ofstream::binary | std::ofstream::trunc);
+    if (!stream.is_open()) {
+        return -1;
+    }
+    const char zeros[64] = {0};
+    stream.write((const char *) &header, sizeof(header));
+    stream.write(zeros, header.keys_offset - sizeof(header));
+    size_t b = 0;
+    size_t a = 0;
+    for (size_t i = 0; i < header.count; i++) {
+        bool from_base = a == solved.size() || (b < this->base_count && this->base_keys[b] < solved[a].first);
+        uint64_t key = from_base ? this->base_keys[b] : solved[a].first;
+        uint8_t result = from_base ? (this->base_results[b / 4] >> (b % 4 * 2)) & 3 : solved[a].second;
+        stream.write((const char *) &key, sizeof(key));
+        results[i / 4] |= result << (i % 4 * 2);
+        if (from_base) {
+            b++;
+        } else {
+            a++;
+        }
+    }
+    stream.write(zeros, header.results_offset - header.keys_offset - header.count * sizeof(uint64_t));
+    stream.write((const char *) results.data(), results.size());
+    stream.close();
+    if (!stream || rename(tmp.c_str(), fname.c_str()) != 0) {
+        return -1;
+    }
+    return (long) header.count;
+}
+
+
+/**
+ * Drop the loaded file mapping
+ * @return void
+ */
+void Tablebase::unmap() {
+    if (this->map_addr) {
+        munmap(this->map_addr, this->map_len);
+    }
+    this->map_addr = nullptr;
+    this->map_len = 0;
+    this->base_keys = nullptr;
+    this->base_results = nullptr;
+    this->base_count = 0;
+}
+
+
+int Tablebase::empty() {
+    return this->n_empty;
+}
+
+
+size_t Tablebase::size() {
+    return this->base_count + this->added.size();
+}
+
+
+long Tablebase::probes() {
+    return this->ct_probes;
+}
+
+
+long Tablebase::solves() {
+    return this->ct_solves;
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+
+/**
+ * Tablebase file layout: this header, then the sorted position keys at
+ * keys_offset (see Tablebase::canonicalKey) and their results at
+ * results_offset, 2 bits each, 4 per byte from the low bits up
+ * (Tablebase::TIE / RED_WINS / BLACK_WINS).
+ */
+struct TablebaseHeader {
+    // TABLEBASE_MAGIC
+    char magic[8];
+    // TABLEBASE_VERSION
+    uint32_t version;
+    // Empty cells of every position held
+    uint32_t empty;
+    // Number of positions
+    uint64_t count;
+    // Byte offset of the sorted key array
+    uint64_t keys_offset;
+    // Byte offset of the packed results
+    uint64_t results_offset;
+};
+
+static const char TABLEBASE_MAGIC[8] = {'C', '4', 'T', 'B', 'A', 'S', 'E', '\n'};
+static const uint32_t TABLEBASE_VERSION = 1;
+
+
+/**
+ * Tablebase class
+ *
+ * Exact results (perfect play by both sides) of the positions with a
+ * given number of empty cells, for training to end a game on as soon as
+ * it gets that far. A game reaches the boundary once at most, with
+ * exactly that many cells left, so no other positions are held.
+ *
+ * Positions are solved (Tablebase::solve) the first time they are
+ * probed and kept; save writes every result, the loaded file's and the
+ * new ones, and load maps a saved file (read only, searched by binary
+ * search) so later runs start with what earlier ones solved. A position
+ * and its left-right mirror share a result and an entry.
+ *
+ * Not thread safe, probe adds to the tablebase.
+ */
+
+class Tablebase {
+    public:
+        // Results, as stored
+        static const uint8_t TIE = 0;
+        static const uint8_t RED_WINS = 1;
+        static const uint8_t BLACK_WINS = 2;
+
+        /**
+         * Tablebase Constructor, empty until load or probe
+         * @param empty the empty cells of the positions held (the cost of
+         * a solve grows quickly with it, beyond about 14)
+         */
+        Tablebase(int empty);
+
+        /**
+         * Tablebase Destructor, unmaps the loaded file
+         */
+        ~Tablebase();
+
+        Tablebase(const Tablebase &) = delete;
+        Tablebase & operator=(const Tablebase &) = delete;
+
+        /**
+         * The exact result of a position, if it is on the boundary: looked
+         * up, or solved and kept
+         * @param position bitboard of player 1's (red's) pieces
+         * @param mask bitboard of every occupied cell
+         * @param winner set to 1 if red wins, -1 if black wins, 0 on a tie
+         * @return true if the position has exactly empty() empty cells
+         * (and so winner was set)
+         */
+        bool probe(uint64_t position, uint64_t mask, int & winner);
+
+        /**
+         * Solve a position exactly, by alpha-beta to the end of the game
+         * @param position bitboard of the side to move's pieces
+         * @param mask bitboard of every occupied cell
+         * @return 1 if the side to move wins, -1 if it loses, 0 on a tie
+         */
+        static int solve(uint64_t position, uint64_t mask);
+
+        /**
+         * Key of a position and its mirror: the smaller of the two
+         * positions' position + mask (exact, see DecisionCache::positionKey)
+         * @param position bitboard of player 1's pieces
+         * @param mask bitboard of every occupied cell
+         * @return the key
+         */
+        static uint64_t canonicalKey(uint64_t position, uint64_t mask);
+
+        /**
+         * Map a file written by save, replacing what the tablebase held
+         * @param fname the file to read
+         * @return the number of positions, -1 if the file can't be opened,
+         * -2 if it is not a tablebase of empty() empty cells
+         */
+        long load(std::string fname);
+
+        /**
+         * Write every result (loaded and solved), sorted by key, through
+         * fname.tmp and a rename
+         * @param fname the file to write
+         * @return the number of positions written, -1 on file error
+         */
+        long save(std::string fname);
+
+        /**
+         * @return the empty cells of the positions held
+         */
+        int empty();
+
+        /**
+         * @return the number of positions held
+         */
+        size_t size();
+
+        /**
+         * @return the positions probed on the boundary
+         */
+        long probes();
+
+        /**
+         * @return the probes that had to be solved
+         */
+        long solves();
+
+    private:
+        int n_empty;
+        // The loaded file, nullptr for none
+        void * map_addr;
+        size_t map_len;
+        const uint64_t * base_keys;
+        const uint8_t * base_results;
+        size_t base_count;
+        // Results solved since the load, by key
+        std::unordered_map<uint64_t, uint8_t> added;
+        long ct_probes;
+        long ct_solves;
+
+        /**
+         * Negamax with alpha-beta on results only (-1, 0, 1)
+         * @return the result for the side to move
+         */
+        static int negamax(uint64_t position, uint64_t mask, int alpha, int beta);
+
+        /**
+         * Drop the loaded file mapping
+         * @return void
+         */
+        void unmap();
+};
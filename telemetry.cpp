@@ -0,0 +1,120 @@
+#include "telemetry.h"
+#include <iomanip>
+
+/**
+ * Telemetry class
+ *
+ * Training counters streamed to a file, see telemetry.h.
+ */
+
+
+/**
+ * Telemetry Constructor
+ * @param fname the file to write rows to (truncated)
+ * @param csv true for CSV (with a header row), false for JSONL
+ * @param every_games games per row
+ */
+Telemetry::Telemetry(std::string fname, bool csv, int every_games) : out(fname) {
+    this->csv = csv;
+    this->every_games = every_games < 1 ? 1 : every_games;
+    this->games = 0;
+    this->ct_timed = 0;
+    this->start = std::chrono::steady_clock::now();
+    this->last_row = this->start;
+    this->last_lap = this->start;
+}
+
+
+bool Telemetry::isOpen() {
+    return this->out.is_open();
+}
+
+
+/**
+ * Count a finished game, writing a row if one is due
+ * @return void
+ */
+void Telemetry::endGame(int winner, int epoch, QTable * red, QTable * black) {
+    if (winner == 1) {
+        this->counters.red_wins++;
+    } else if (winner == -1) {
+        this->counters.black_wins++;
+    } else {
+        this->counters.ties++;
+    }
+    if (++this->games >= this->every_games) {
+        write(epoch, red, black);
+    }
+}
+
+
+/**
+ * Write a row for the games since the last one, if any
+ * @return void
+ */
+void Telemetry::finish(int epoch, QTable * red, QTable * black) {
+    if (this->games) {
+        write(epoch, red, black);
+    }
+    this->out.flush();
+}
+
+
+/**
+ * Write a row of the counters and reset them. Times are per timed
+ * half-move (reset per timed game), rates are over the row's games.
+ * @return void
+ */
+void Telemetry::write(int epoch, QTable * red, QTable * black) {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::chrono::duration<double> row_secs = now - this->last_row;
+    std::chrono::duration<double> secs = now - this->start;
+    TelemetryCounters & c = this->counters;
+    double games = this->games;
+    double timed_moves = c.timed_moves ? (double) c.timed_moves : 1;
+    double timed_games = c.timed_games ? (double) c.timed_games : 1;
+
+    const int n_fields = 24;
+    const char * names[n_fields] = {
+        "game", "secs", "games_per_sec", "moves", "lookups", "hits", "misses", "inserts", "hit_rate",
+        "red_states", "red_bytes", "red_evictions", "black_states", "black_bytes", "black_evictions", "select_ns_per_move", "drop_ns_per_move",
+        "update_ns_per_move", "reset_ns_per_game", "invalid_moves", "fallbacks", "red_win_rate",
+        "black_win_rate", "tie_rate"
+    };
+    double values[n_fields] = {
+        (double) epoch, secs.count(), games / row_secs.count(), (double) c.moves,
+        (double) c.lookups, (double) c.hits, (double) c.misses, (double) c.inserts,
+        c.lookups ? (double) c.hits / c.lookups : 0,
+        (double) red->size(), (double) red->bytes(), (double) red->evictions(),
+        (double) black->size(), (double) black->bytes(), (double) black->evictions(),
+        c.select_ns / timed_moves, c.drop_ns / timed_moves, c.update_ns / timed_moves, c.reset_ns / timed_games,
+        (double) c.invalid_moves, (double) c.fallbacks, c.red_wins / games,
+        c.black_wins / games, c.ties / games
+    };
+
+    this->out << std::setprecision(10);
+    if (this->csv) {
+        // header before the first row
+        if (this->out.tellp() == 0) {
+            for (int f = 0; f < n_fields; f++) {
+                this->out << (f ? "," : "") << names[f];
+            }
+            this->out << "\n";
+        }
+        for (int f = 0; f < n_fields; f++) {
+            this->out << (f ? "," : "") << values[f];
+        }
+        this->out << "\n";
+    } else {
+        this->out << "{";
+        for (int f = 0; f < n_fields; f++) {
+            this->out << (f ? ", \"" : "\"") << names[f] << "\": " << values[f];
+        }
+        this->out << "}\n";
+    }
+    this->out.flush();
+
+    this->counters = TelemetryCounters();
+    this->games = 0;
+    this->last_row = now;
+}
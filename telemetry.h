@@ -0,0 +1,127 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include "qtable.h"
+
+
+/**
+ * Counts gathered while training, reset after every telemetry row
+ */
+struct TelemetryCounters {
+    // Q table lookups by the learners: found / not found, states added
+    uint64_t lookups = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t inserts = 0;
+    // Half-moves played, drops into a full column (lost turns), greedy
+    // moves with no window over an open column
+    uint64_t moves = 0;
+    uint64_t invalid_moves = 0;
+    uint64_t fallbacks = 0;
+    // Time choosing moves, dropping pieces (with the win check),
+    // updating tables and resetting boards, over the timed half-moves /
+    // games only (see timeThis)
+    uint64_t timed_moves = 0;
+    uint64_t timed_games = 0;
+    uint64_t select_ns = 0;
+    uint64_t drop_ns = 0;
+    uint64_t update_ns = 0;
+    uint64_t reset_ns = 0;
+    // Games ended by result
+    uint64_t red_wins = 0;
+    uint64_t black_wins = 0;
+    uint64_t ties = 0;
+};
+
+
+/**
+ * Telemetry class
+ *
+ * A Telemetry streams training counters to a file, one row (a JSON line
+ * or CSV record) every every_games games. Learners and training loops
+ * hold a Telemetry pointer that is nullptr when telemetry is off, so the
+ * only cost then is that check. Counts are exact; times come from one
+ * game (or batch step) in TIME_EVERY, as reading the clock costs about
+ * as much as a table lookup.
+ */
+
+class Telemetry {
+    public:
+        /**
+         * Telemetry Constructor
+         * @param fname the file to write rows to (truncated)
+         * @param csv true for CSV (with a header row), false for JSONL
+         * @param every_games games per row
+         */
+        Telemetry(std::string fname, bool csv, int every_games);
+
+        // Games (or batch steps) per timed one
+        static const int TIME_EVERY = 16;
+
+        /**
+         * @return true if the file is open for writing
+         */
+        bool isOpen();
+
+        /**
+         * Whether to time the next game (or batch step), true once
+         * every TIME_EVERY calls
+         */
+        bool timeThis() {
+            return ++this->ct_timed % TIME_EVERY == 0;
+        }
+
+        /**
+         * Add the time since the last lap to a counter, and start the
+         * next lap
+         * @param bucket the counter to add to, nullptr to only start a lap
+         * @return void
+         */
+        void lap(uint64_t * bucket) {
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if (bucket) {
+                *bucket += std::chrono::duration_cast<std::chrono::nanoseconds>(now - this->last_lap).count();
+            }
+            this->last_lap = now;
+        }
+
+        /**
+         * Count a finished game, writing a row if one is due
+         * @param winner 1 red, -1 black, 0 tie
+         * @param epoch the number of games played, this one included
+         * @param red the trained AI's table
+         * @param black the opponent's table
+         * @return void
+         */
+        void endGame(int winner, int epoch, QTable * red, QTable * black);
+
+        /**
+         * Write a row for the games since the last one, if any
+         * @return void
+         */
+        void finish(int epoch, QTable * red, QTable * black);
+
+        // Counts since the last row, incremented directly by the hot path
+        TelemetryCounters counters;
+
+    private:
+        std::ofstream out;
+        bool csv;
+        int every_games;
+        // Games since the last row
+        int games;
+        // Calls of timeThis
+        unsigned ct_timed;
+        std::chrono::steady_clock::time_point last_lap;
+        std::chrono::steady_clock::time_point last_row;
+        std::chrono::steady_clock::time_point start;
+
+        /**
+         * Write a row of the counters and reset them
+         * @return void
+         */
+        void write(int epoch, QTable * red, QTable * black);
+};
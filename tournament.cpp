@@ -0,0 +1,303 @@
+#include "tournament.h"
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <random>
+#include <thread>
+
+/**
+ * Round-robin tournament, see tournament.h.
+ */
+
+
+/**
+ * Take the first game of the range (the owner)
+ * @return the game index, -1 if the range is empty
+ */
+long GameRange::take() {
+    uint64_t r = this->range.load();
+    while (true) {
+        uint64_t lo = r >> 32;
+        uint64_t hi = r & 0xffffffffULL;
+        if (lo >= hi) {
+            return -1;
+        }
+        if (this->range.compare_exchange_weak(r, ((lo + 1) << 32) | hi)) {
+            return (long) lo;
+        }
+    }
+}
+
+
+/**
+ * Take the back half of the range (a thief)
+ * @return the game index, -1 if the range is empty
+ */
+long GameRange::steal(GameRange & into) {
+    uint64_t r = this->range.load();
+    while (true) {
+        uint64_t lo = r >> 32;
+        uint64_t hi = r & 0xffffffffULL;
+        if (lo >= hi) {
+            return -1;
+        }
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (this->range.compare_exchange_weak(r, (lo << 32) | mid)) {
+            into.range.store(((mid + 1) << 32) | hi);
+            return (long) mid;
+        }
+    }
+}
+
+
+/**
+ * A worker's games and its share of the scores
+ */
+struct TournamentWorker {
+    GameRange games;
+    std::vector<std::vector<double>> score;
+    long steals;
+    SearchTotals search;
+};
+
+
+/**
+ * Plays a round-robin tournament between loaded tables
+ * @return non-zero on error
+ */
+template <int N>
+int playTournament(std::vector<QPolicy<N> *> & players, TournamentOptions & opts, TournamentResults & results) {
+    int k = (int) players.size();
+    if (k < 2 || opts.games_per_pair < 1) {
+        return -1;
+    }
+    int n_threads = std::max(1, opts.n_threads);
+    // game g is game g % games_per_pair of the g / games_per_pair'th pairing
+    std::vector<std::pair<int, int>> pairings;
+    for (int i = 0; i < k; i++) {
+        for (int j = i + 1; j < k; j++) {
+            pairings.push_back({i, j});
+        }
+    }
+    long n_games = (long) pairings.size() * opts.games_per_pair;
+    if (n_games >= (1L << 32)) {
+        return -1;
+    }
+
+    std::vector<TournamentWorker *> workers;
+    for (int t = 0; t < n_threads; t++) {
+        TournamentWorker * w = new TournamentWorker();
+        uint64_t lo = n_games * t / n_threads;
+        uint64_t hi = n_games * (t + 1) / n_threads;
+        w->games.range.store((lo << 32) | hi);
+        w->score.assign(k, std::vector<double>(k, 0));
+        w->steals = 0;
+        workers.push_back(w);
+    }
+
+    std::chrono::steady_clock::time_point begin_time = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < n_threads; t++) {
+        threads.push_back(std::thread([&workers, &players, &pairings, &opts, t, n_threads]() {
+            TournamentWorker * w = workers[t];
+            // searches keep state, one per table per worker
+            std::vector<QSearch<N> *> searches(players.size(), nullptr);
+            for (size_t p = 0; p < players.size() && opts.move_ms > 0; p++) {
+                searches[p] = new QSearch<N>(players[p]);
+            }
+            while (true) {
+                long g = w->games.take();
+                // out of games, steal from the next workers round
+                for (int v = 1; g < 0 && v < n_threads; v++) {
+                    g = workers[(t + v) % n_threads]->games.steal(w->games);
+                    w->steals += g >= 0;
+                }
+                if (g < 0) {
+                    break;
+                }
+                std::pair<int, int> pairing = pairings[g / opts.games_per_pair];
+                int game = g % opts.games_per_pair;
+                // both games of a color swapped pair open the same way
+                int red = game % 2 ? pairing.second : pairing.first;
+                int black = game % 2 ? pairing.first : pairing.second;
+                uint64_t seed = opts.seed * 0x9e3779b97f4a7c15ULL + (uint64_t) (g - game % 2);
+                int winner = playTournamentGame(*players[red], *players[black], opts.opening_moves, seed,
+                                                searches[red], searches[black], opts.move_ms, &w->search);
+                w->score[red][black] += winner == 1 ? 1 : winner == 0 ? 0.5 : 0;
+                w->score[black][red] += winner == -1 ? 1 : winner == 0 ? 0.5 : 0;
+            }
+            for (QSearch<N> * search : searches) {
+                delete search;
+            }
+        }));
+    }
+    for (std::thread & thread : threads) {
+        thread.join();
+    }
+    std::chrono::duration<double> t = std::chrono::steady_clock::now() - begin_time;
+
+    results.score.assign(k, std::vector<double>(k, 0));
+    results.games.assign(k, std::vector<int>(k, 0));
+    results.steals = 0;
+    results.secs = t.count();
+    results.search = SearchTotals();
+    for (std::pair<int, int> & pairing : pairings) {
+        results.games[pairing.first][pairing.second] = opts.games_per_pair;
+        results.games[pairing.second][pairing.first] = opts.games_per_pair;
+    }
+    for (TournamentWorker * w : workers) {
+        for (int i = 0; i < k; i++) {
+            for (int j = 0; j < k; j++) {
+                results.score[i][j] += w->score[i][j];
+            }
+        }
+        results.steals += w->steals;
+        results.search.add(w->search);
+        delete w;
+    }
+    results.elo = eloRatings(results.score, results.games);
+    return 0;
+}
+
+
+/**
+ * Plays one game between two policies from a random opening, greedy or
+ * searched
+ * @return 1 if red won, -1 if black won, 0 on a tie
+ */
+template <int N>
+int playTournamentGame(const QPolicy<N> & red, const QPolicy<N> & black, int opening_moves, uint64_t seed,
+                       QSearch<N> * red_search, QSearch<N> * black_search, int move_ms, SearchTotals * totals) {
+    Game game;
+    std::mt19937_64 rng(seed);
+    int player = 1;
+    bool won = false;
+    for (int ply = 0; ply < opening_moves && !game.boardIsFull(); ply++) {
+        uint32_t legal = game.legalMoves();
+        int pick = (int) (rng() % __builtin_popcount(legal));
+        // the pick'th legal column
+        for (int p = 0; p < pick; p++) {
+            legal &= legal - 1;
+        }
+        game.dropPiece(__builtin_ctz(legal), player, won);
+        player = -player;
+    }
+
+    while (!game.boardIsFull()) {
+        // the policy to move sees its own pieces as player 1
+        uint64_t position = player == 1 ? game.getPosition() : game.getPosition() ^ game.getMask();
+        uint64_t mask = game.getMask();
+        QSearch<N> * search = player == 1 ? red_search : black_search;
+        int move;
+        if (search) {
+            SearchStats stats;
+            move = search->selectMove(position, mask, move_ms, 42, &stats);
+            if (totals) {
+                totals->add(stats);
+            }
+        } else {
+            move = player == 1 ? red.selectMove(position, mask) : black.selectMove(position, mask);
+        }
+        game.dropPiece(move, player, won);
+        if (won) {
+            return player;
+        }
+        player = -player;
+    }
+    return 0;
+}
+
+
+/**
+ * Fits Elo ratings to a score table (Bradley-Terry by minorization-
+ * maximization)
+ * @return the rating of each table
+ */
+std::vector<double> eloRatings(const std::vector<std::vector<double>> & score,
+                               const std::vector<std::vector<int>> & games) {
+    int k = (int) score.size();
+    std::vector<double> strength(k, 1);
+    for (int iter = 0; iter < 1000; iter++) {
+        std::vector<double> next(k);
+        double change = 0;
+        for (int i = 0; i < k; i++) {
+            double wins = 0;
+            double expected = 0;
+            for (int j = 0; j < k; j++) {
+                if (j == i || !games[i][j]) {
+                    continue;
+                }
+                // one extra draw per pairing
+                wins += score[i][j] + 0.5;
+                expected += (games[i][j] + 1) / (strength[i] + strength[j]);
+            }
+            next[i] = expected > 0 ? wins / expected : 1;
+        }
+        // strengths are only relative, keep their geometric mean at 1
+        double log_mean = 0;
+        for (int i = 0; i < k; i++) {
+            log_mean += std::log(next[i]) / k;
+        }
+        for (int i = 0; i < k; i++) {
+            next[i] /= std::exp(log_mean);
+            change = std::max(change, std::fabs(std::log(next[i] / strength[i])));
+        }
+        strength = next;
+        if (change < 1e-9) {
+            break;
+        }
+    }
+    std::vector<double> elo(k);
+    for (int i = 0; i < k; i++) {
+        elo[i] = 1500 + 400 * std::log10(strength[i]);
+    }
+    return elo;
+}
+
+
+/**
+ * Prints the win rate matrix and the tables ranked by Elo
+ * @return void
+ */
+void printTournament(std::vector<std::string> & names, TournamentResults & results) {
+    int k = (int) names.size();
+    std::cout << std::endl << "\033[1;36mWIN RATE %\033[0m (row against column, ties count half)" << std::endl;
+    std::cout << "     ";
+    for (int j = 0; j < k; j++) {
+        std::cout << std::setw(7) << j + 1;
+    }
+    std::cout << std::endl;
+    for (int i = 0; i < k; i++) {
+        std::cout << std::setw(4) << i + 1 << " ";
+        for (int j = 0; j < k; j++) {
+            if (i == j || !results.games[i][j]) {
+                std::cout << std::setw(7) << "-";
+            } else {
+                std::cout << std::setw(7) << std::fixed << std::setprecision(1)
+                          << 100.0 * results.score[i][j] / results.games[i][j];
+            }
+        }
+        std::cout << "  " << names[i] << std::endl;
+    }
+
+    std::vector<int> rank(k);
+    for (int i = 0; i < k; i++) {
+        rank[i] = i;
+    }
+    std::sort(rank.begin(), rank.end(), [&](int a, int b) { return results.elo[a] > results.elo[b]; });
+    std::cout << std::endl << "\033[1;36mELO\033[0m" << std::endl;
+    for (int r = 0; r < k; r++) {
+        int i = rank[r];
+        double played = 0;
+        double scored = 0;
+        for (int j = 0; j < k; j++) {
+            played += results.games[i][j];
+            scored += results.score[i][j];
+        }
+        std::cout << std::setw(4) << r + 1 << ". " << std::setw(6) << std::fixed << std::setprecision(0)
+                  << results.elo[i] << "  " << std::setprecision(1) << 100.0 * scored / played << "%  "
+                  << "(" << i + 1 << ") " << names[i] << std::endl;
+    }
+    std::cout.unsetf(std::ios::fixed);
+    std::cout << std::setprecision(6);
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include "game.h"
+#include "policy.h"
+#include "search.h"
+
+
+/**
+ * Round-robin tournament
+ *
+ * Every pair of K loaded Q tables plays games_per_pair greedy games, the
+ * colors swapped from one game to the next. Greedy play is deterministic,
+ * so each game pair opens with the same few random plies (seeded by the
+ * pairing and game), and a tournament plays out the same at any thread
+ * count. Both sides see the board as player 1, as their tables were
+ * trained: black is shown the board with the colors swapped.
+ *
+ * The games are spread over worker threads with work stealing: each
+ * worker starts with an even slice of the game indices and takes them
+ * front to back, a worker out of games takes the back half of another's
+ * slice. Every worker plays the same policies (QPolicy), the loaded
+ * tables are only read.
+ *
+ * With a move time (move_ms) every move after the opening is searched
+ * (QSearch, one per table per worker) instead of greedy. How deep a
+ * search gets depends on the machine and its load, so searched games
+ * don't replay exactly.
+ */
+
+/**
+ * Options for a tournament
+ */
+struct TournamentOptions {
+    // Games per pair of tables, the colors alternating
+    int games_per_pair = 100;
+    // Worker threads
+    int n_threads = 1;
+    // Random plies each game pair opens with (at most 6, which can't win)
+    int opening_moves = 4;
+    // Seed of the openings
+    uint64_t seed = 1;
+    // Search time per move in milliseconds, 0 for greedy play
+    int move_ms = 0;
+};
+
+/**
+ * Results of a tournament, indexed by table
+ */
+struct TournamentResults {
+    // score[i][j]: i's wins against j plus half the ties
+    std::vector<std::vector<double>> score;
+    // games[i][j]: games played between i and j
+    std::vector<std::vector<int>> games;
+    // Elo rating of each table (see eloRatings)
+    std::vector<double> elo;
+    // Games taken from another worker's slice
+    long steals = 0;
+    // Wall clock time of the games
+    double secs = 0;
+    // The searched moves (move_ms)
+    SearchTotals search;
+};
+
+/**
+ * Game indices a worker has left to play, [lo, hi) packed as lo << 32 | hi
+ * so the owner and thieves both claim games with one compare-and-swap
+ * (a range is only ever swapped for a smaller part of itself, so an old
+ * value read again is still correct to swap from). Cache line sized so
+ * workers don't share lines.
+ */
+struct alignas(64) GameRange {
+    std::atomic<uint64_t> range;
+
+    /**
+     * Take the first game of the range (the owner)
+     * @return the game index, -1 if the range is empty
+     */
+    long take();
+
+    /**
+     * Take the back half of the range (a thief), the first game of which
+     * is returned and the rest put in the thief's own (empty) range
+     * @param into the thief's range
+     * @return the game index, -1 if the range is empty
+     */
+    long steal(GameRange & into);
+};
+
+/**
+ * Plays a round-robin tournament between loaded tables, see above.
+ * @param players a policy per table
+ * @param opts games, threads and openings
+ * @param results set to the scores and Elo ratings
+ * @return non-zero on error
+ */
+template <int N>
+int playTournament(std::vector<QPolicy<N> *> & players, TournamentOptions & opts, TournamentResults & results);
+
+/**
+ * Plays one game between two policies from a random opening, greedy or
+ * searched
+ * @param red the policy moving first
+ * @param black the policy moving second
+ * @param opening_moves random plies played before the learners move
+ * @param seed seed of the opening
+ * @param red_search red's search, nullptr for greedy play
+ * @param black_search black's search, nullptr for greedy play
+ * @param move_ms search time per move
+ * @param totals the searches are added to it, may be nullptr
+ * @return 1 if red won, -1 if black won, 0 on a tie
+ */
+template <int N>
+int playTournamentGame(const QPolicy<N> & red, const QPolicy<N> & black, int opening_moves, uint64_t seed,
+                       QSearch<N> * red_search = nullptr, QSearch<N> * black_search = nullptr, int move_ms = 0,
+                       SearchTotals * totals = nullptr);
+
+/**
+ * Fits Elo ratings to a score table (Bradley-Terry by minorization-
+ * maximization), each pairing given one extra drawn game so a table that
+ * never scores still gets a finite rating. The ratings average 1500.
+ * @param score score[i][j] is i's wins against j plus half the ties
+ * @param games games[i][j] is the number of games between i and j
+ * @return the rating of each table
+ */
+std::vector<double> eloRatings(const std::vector<std::vector<double>> & score,
+                               const std::vector<std::vector<int>> & games);
+
+/**
+ * Prints the win rate matrix and the tables ranked by Elo
+ * @param names the name of each table
+ * @param results the tournament results
+ * @return void
+ */
+void printTournament(std::vector<std::string> & names, TournamentResults & results);
@@ -0,0 +1,365 @@
+#include "train.h"
+
+/**
+ * Self-play training, see train.h.
+ */
+
+
+/**
+ * Trains two given AI against one another in a given Game.
+ * @param red the winner AI (moves first)
+ * @param black the loser AI (moves second)
+ * @param game the Game obj. that the two AIs are playing in
+ * @param n_epochs total number of epochs to train for
+ * @param opts resume point and checkpointing
+ * @return non-zero on error
+ */
+template <int N>
+int trainAI(QLearner<N> * red, QLearner<N> * black, Game * game, int n_epochs, TrainOptions & opts) {
+    // wall time, so the rate matches what a user sees
+    std::chrono::steady_clock::time_point begin_time = std::chrono::steady_clock::now();
+    int red_wins = opts.red_wins;
+    int ties = opts.ties;
+    // how often to print info
+    int info_epochs = 1000;
+    // half-moves played
+    long ct_moves = 0;
+#ifdef QL_COUNT_ALLOCS
+    // allocations / table growths / moves after the first info_epochs games
+    long allocs_start = 0;
+    int growths_start = 0;
+#endif
+
+    // Play n_epochs matches in training mode
+    for (int i = opts.start_epoch; i < n_epochs; i++) {
+
+        // snapshot between games, written in the background
+        if (opts.checkpointer) {
+            opts.checkpointer->poll(i, red, black, red_wins, ties);
+        }
+
+        // Small tool for tracking speed and progress of training
+        if (i % info_epochs == 0 && i != opts.start_epoch) {
+            std::chrono::duration<double> t = std::chrono::steady_clock::now() - begin_time;
+            std::cout << "\r\033[1;36mGAME: " << i << "/" << n_epochs << " games/sec: " <<(int)(info_epochs / t.count())<< "\033[0m" << std::flush;
+            begin_time = std::chrono::steady_clock::now();
+        }
+#ifdef QL_COUNT_ALLOCS
+        if (i == opts.start_epoch + info_epochs) {
+            allocs_start = ct_allocations;
+            growths_start = red->getTable()->growths() + black->getTable()->growths();
+            ct_moves = 0;
+        }
+#endif
+
+        // Play until a win or full board
+        int winner = playTrainingGame(red, black, game, ct_moves, opts.telemetry, opts.tablebase);
+        if (winner == 1) {
+            red_wins++;
+        } else if (winner == 0) {
+            ties++;
+        }
+        if (opts.telemetry) {
+            opts.telemetry->endGame(winner, i + 1, red->getTable(), black->getTable());
+        }
+    }
+    red->flushUpdates();
+    black->flushUpdates();
+    if (opts.telemetry) {
+        opts.telemetry->finish(n_epochs, red->getTable(), black->getTable());
+    }
+    std::cout << std::endl<<"\033[1;36mSTOP TRAINING\033[0m";
+    std::cout << std::endl<<"\033[1;36m";
+    std::cout << red_wins << ":" << (n_epochs-red_wins) << ":" << ties;
+    std::cout << "\033[0m" << std::endl;
+#ifdef QL_COUNT_ALLOCS
+    // each table growth makes 3 allocations (keys, rewards and visit
+    // counts), the rest come from the move path and should be 0
+    int growths = red->getTable()->growths() + black->getTable()->growths() - growths_start;
+    long allocs = ct_allocations - allocs_start;
+    std::cout << "ALLOCATIONS: " << allocs << " over " << ct_moves << " moves, ";
+    std::cout << 3 * growths << " from " << growths << " table growths" << std::endl;
+#endif
+
+    return 0;
+}
+
+
+/**
+ * Trains two given AI against one another on a GameBatch: batch_size
+ * games are played in lockstep, every board stepped at once per
+ * half-move, and a finished board starts the next game.
+ * Each board has its own Game view (for the learners' windows) and a
+ * pair of learners sharing red's / black's table, so every game keeps
+ * its own state across moves like playTrainingGame.
+ * @param red the winner AI (moves first)
+ * @param black the loser AI (moves second)
+ * @param n_epochs total number of epochs to train for
+ * @param batch_size games in flight at once
+ * @param opts resume point and checkpointing
+ * @return non-zero on error
+ */
+template <int N>
+int trainBatch(QLearner<N> * red, QLearner<N> * black, int n_epochs, int batch_size, TrainOptions & opts) {
+    // wall time, so the rate matches what a user sees
+    std::chrono::steady_clock::time_point begin_time = std::chrono::steady_clock::now();
+    int red_wins = opts.red_wins;
+    int ties = opts.ties;
+    // how often to print info
+    int info_epochs = 1000;
+    int n = std::max(1, std::min(batch_size, n_epochs - opts.start_epoch));
+
+    GameBatch batch(n);
+    std::vector<Game> views(n);
+    std::vector<QLearner<N> *> reds, blacks;
+    for (int k = 0; k < n; k++) {
+        reds.push_back(new QLearner<N>(&views[k], red));
+        reds[k]->useTableOf(red);
+        reds[k]->setTelemetry(opts.telemetry);
+        blacks.push_back(new QLearner<N>(&views[k], black));
+        blacks[k]->useTableOf(black);
+        blacks[k]->setTelemetry(opts.telemetry);
+    }
+    Telemetry * telemetry = opts.telemetry;
+    TelemetryCounters * c = telemetry ? &telemetry->counters : nullptr;
+    std::vector<int> moves(n);
+    std::vector<int> winners(n);
+    std::vector<uint8_t> status(n);
+    std::vector<uint8_t> done(n);
+    // boards playing a game, games begun / finished
+    std::vector<uint8_t> active(n, 1);
+    int begun = opts.start_epoch + n;
+    int finished = opts.start_epoch;
+
+    while (finished < n_epochs) {
+        // snapshot between steps, in-flight games are not saved
+        if (opts.checkpointer) {
+            opts.checkpointer->poll(finished, red, black, red_wins, ties);
+        }
+
+        // red moves on every active board, the clock is read in sampled
+        // steps only
+        Telemetry * timer = (c && telemetry->timeThis()) ? telemetry : nullptr;
+        if (timer) {
+            timer->lap(nullptr);
+        }
+        for (int k = 0; k < n; k++) {
+            moves[k] = active[k] ? reds[k]->makeMove(true) : -1;
+        }
+        if (timer) {
+            timer->lap(&c->select_ns);
+        }
+        batch.dropPieces(moves.data(), 1, status.data());
+        if (timer) {
+            timer->lap(&c->drop_ns);
+        }
+        if (c) {
+            for (int k = 0; k < n; k++) {
+                c->moves += active[k];
+                c->timed_moves += timer && active[k];
+                c->invalid_moves += active[k] && (status[k] & GameBatch::INVALID);
+            }
+        }
+        for (int k = 0; k < n; k++) {
+            winners[k] = 0;
+            done[k] = 0;
+            if (!active[k]) {
+                continue;
+            }
+            views[k].setPosition(batch.getPosition(k), batch.getMask(k));
+            winners[k] = (status[k] & GameBatch::WON) ? 1 : 0;
+            reds[k]->update(winners[k], moves[k]);
+            done[k] = winners[k] || (status[k] & GameBatch::FULL);
+        }
+        if (timer) {
+            timer->lap(&c->update_ns);
+        }
+
+        // black moves where red didn't end the game
+        for (int k = 0; k < n; k++) {
+            moves[k] = (active[k] && !done[k]) ? blacks[k]->makeMove(true) : -1;
+        }
+        if (timer) {
+            timer->lap(&c->select_ns);
+        }
+        batch.dropPieces(moves.data(), -1, status.data());
+        if (timer) {
+            timer->lap(&c->drop_ns);
+        }
+        if (c) {
+            for (int k = 0; k < n; k++) {
+                c->moves += moves[k] >= 0;
+                c->timed_moves += timer && moves[k] >= 0;
+                c->invalid_moves += moves[k] >= 0 && (status[k] & GameBatch::INVALID);
+            }
+        }
+        for (int k = 0; k < n; k++) {
+            if (!active[k] || done[k]) {
+                continue;
+            }
+            views[k].setPosition(batch.getPosition(k), batch.getMask(k));
+            winners[k] = (status[k] & GameBatch::WON) ? -1 : 0;
+            blacks[k]->update(winners[k], moves[k]);
+            done[k] = winners[k] || (status[k] & GameBatch::FULL);
+        }
+        if (timer) {
+            timer->lap(&c->update_ns);
+        }
+
+        // On win, record, reset, and restart - adjust Qs accordingly
+        for (int k = 0; k < n; k++) {
+            if (!done[k]) {
+                continue;
+            }
+            if (winners[k] == 1) {
+                blacks[k]->updateLoss();
+                red_wins++;
+            } else if (winners[k] == -1) {
+                reds[k]->updateLoss();
+            } else {
+                ties++;
+            }
+            views[k].resetGame();
+            finished++;
+            if (telemetry) {
+                c->timed_games += timer != nullptr;
+                telemetry->endGame(winners[k], finished, red->getTable(), black->getTable());
+            }
+            if (begun < n_epochs) {
+                begun++;
+            } else {
+                active[k] = 0;
+            }
+
+            // Small tool for tracking speed and progress of training
+            if (finished % info_epochs == 0) {
+                std::chrono::duration<double> t = std::chrono::steady_clock::now() - begin_time;
+                std::cout << "\r\033[1;36mGAME: " << finished << "/" << n_epochs << " games/sec: " <<(int)(info_epochs / t.count())<< "\033[0m" << std::flush;
+                begin_time = std::chrono::steady_clock::now();
+            }
+        }
+        batch.resetBoards(done.data());
+        if (timer) {
+            timer->lap(&c->reset_ns);
+        }
+    }
+    // the boards' learners buffer their updates with red's / black's
+    red->flushUpdates();
+    black->flushUpdates();
+    if (telemetry) {
+        telemetry->finish(n_epochs, red->getTable(), black->getTable());
+    }
+    std::cout << std::endl<<"\033[1;36mSTOP TRAINING\033[0m";
+    std::cout << std::endl<<"\033[1;36m";
+    std::cout << red_wins << ":" << (n_epochs-red_wins) << ":" << ties;
+    std::cout << "\033[0m" << std::endl;
+
+    for (int k = 0; k < n; k++) {
+        delete reds[k];
+        delete blacks[k];
+    }
+    return 0;
+}
+
+
+/**
+ * Plays one training game between two AI, updating both Q tables.
+ * @param red the winner AI (moves first)
+ * @param black the loser AI (moves second)
+ * @param game the Game obj., empty on entry and reset on return
+ * @param ct_moves incremented once per half-move
+ * @param telemetry timed and counted into if not nullptr
+ * @param tablebase ends the game early if not nullptr
+ * @return 1 if red won, -1 if black won, 0 on a tie
+ */
+template <int N>
+int playTrainingGame(QLearner<N> * red, QLearner<N> * black, Game * game, long & ct_moves,
+                     Telemetry * telemetry, Tablebase * tablebase) {
+    TelemetryCounters * c = telemetry ? &telemetry->counters : nullptr;
+    // the clock is read in sampled games only
+    Telemetry * timer = (c && telemetry->timeThis()) ? telemetry : nullptr;
+    while (true) {
+        // take turns of two players dropping a piece / checking status
+        // red moves first then update board
+        if (timer) {
+            timer->lap(nullptr);
+        }
+        int move = red->makeMove(true);
+        ct_moves++;
+        if (timer) {
+            timer->lap(&c->select_ns);
+        }
+
+        // only the piece just dropped can complete a line
+        bool won = false;
+        int dropped = game->dropPiece(move, 1, won);
+        int winner = won ? 1 : 0;
+        // a solved position decides the game here, its winner rewarded
+        // as if the game had been played out
+        bool solved = !won && tablebase && tablebase->probe(game->getPosition(), game->getMask(), winner);
+        if (c) {
+            c->moves++;
+            c->invalid_moves += dropped < 0;
+        }
+        if (timer) {
+            timer->lap(&c->drop_ns);
+            c->timed_moves++;
+        }
+
+        // update Q tables of red and black
+        red->update(winner, move);
+        if (timer) {
+            timer->lap(&c->update_ns);
+        }
+
+        // iff there is no winner, black makes it's move then update board
+        if (!winner && !solved && !game->boardIsFull()) {
+            int move = black->makeMove(true);
+            ct_moves++;
+            if (timer) {
+                timer->lap(&c->select_ns);
+            }
+            dropped = game->dropPiece(move, -1, won);
+            if (won) {
+                winner = -1;
+            }
+            solved = !won && tablebase && tablebase->probe(game->getPosition(), game->getMask(), winner);
+            if (c) {
+                c->moves++;
+                c->invalid_moves += dropped < 0;
+            }
+            if (timer) {
+                timer->lap(&c->drop_ns);
+                c->timed_moves++;
+            }
+
+            // update Q tables of red and black
+            black->update(winner, move);
+            if (timer) {
+                timer->lap(&c->update_ns);
+            }
+        }
+
+        // On win, record, reset, and restart - adjust Qs accordingly
+        if (winner) {
+            if (winner == 1) {
+                black->updateLoss();
+            } else {
+                red->updateLoss();
+            }
+            game->resetGame();
+            if (timer) {
+                timer->lap(&c->reset_ns);
+                c->timed_games++;
+            }
+            return winner;
+        } else if (solved || game->boardIsFull()) {
+            game->resetGame();
+            if (timer) {
+                timer->lap(&c->reset_ns);
+                c->timed_games++;
+            }
+            return 0;
+        }
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+#include "game.h"
+#include "gamebatch.h"
+#include "q.h"
+#include "checkpoint.h"
+#include "tablebase.h"
+#include "telemetry.h"
+
+
+/**
+ * Self-play training
+ *
+ * The training loops shared by the driver and the benchmarks: one game
+ * at a time (trainAI), many games in lockstep (trainBatch), and a single
+ * game (playTrainingGame, also run by the parallel workers).
+ */
+
+/**
+ * Options for a training run beyond the epoch count
+ */
+struct TrainOptions {
+    // Game number to start from (non-zero when resuming)
+    int start_epoch = 0;
+    // Red wins / ties carried over when resuming
+    int red_wins = 0;
+    int ties = 0;
+    // Periodic snapshots of training, nullptr for none
+    Checkpointer * checkpointer = nullptr;
+    // Streamed training counters, nullptr for none (the learners must
+    // be given it with QLearner::setTelemetry too)
+    Telemetry * telemetry = nullptr;
+    // Exact results that end a game once it is that close to a full
+    // board, nullptr to play every game out (trainAI only)
+    Tablebase * tablebase = nullptr;
+};
+
+/**
+ * Trains two given AI against one another in a given Game.
+ * @param red the winner AI (moves first)
+ * @param black the loser AI (moves second)
+ * @param game the Game obj. that the two AIs are playing in
+ * @param n_epochs total number of epochs to train for
+ * @param opts resume point and checkpointing
+ * @return non-zero on error
+ */
+template <int N>
+int trainAI(QLearner<N> * red, QLearner<N> * black, Game * game, int n_epochs, TrainOptions & opts);
+
+/**
+ * Trains two given AI against one another on a GameBatch: batch_size
+ * games are played in lockstep, every board stepped at once per
+ * half-move, and a finished board starts the next game.
+ * @param red the winner AI (moves first)
+ * @param black the loser AI (moves second)
+ * @param n_epochs total number of epochs to train for
+ * @param batch_size games in flight at once
+ * @param opts resume point and checkpointing
+ * @return non-zero on error
+ */
+template <int N>
+int trainBatch(QLearner<N> * red, QLearner<N> * black, int n_epochs, int batch_size, TrainOptions & opts);
+
+/**
+ * Plays one training game between two AI, updating both Q tables. With
+ * a tablebase, a game reaching its positions ends there: the move that
+ * reached it is rewarded as the winning or losing move of the solved
+ * result, or as a move to a full board on a solved tie.
+ * @param red the winner AI (moves first)
+ * @param black the loser AI (moves second)
+ * @param game the Game obj., empty on entry and reset on return
+ * @param ct_moves incremented once per half-move
+ * @param telemetry timed and counted into if not nullptr
+ * @param tablebase ends the game early if not nullptr
+ * @return 1 if red won, -1 if black won, 0 on a tie
+ */
+template <int N>
+int playTrainingGame(QLearner<N> * red, QLearner<N> * black, Game * game, long & ct_moves,
+                     Telemetry * telemetry = nullptr, Tablebase * tablebase = nullptr);